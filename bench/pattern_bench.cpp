@@ -0,0 +1,43 @@
+// time pattern_formatter against the static formatter built from the same pattern.
+// the clock moves 1us per message, so the per-second caching of pattern_formatter is exercised too.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sspdlog/sspdlog.h>
+
+#define BENCH_PATTERN "[%Y-%m-%d %H:%M:%S.%e] [%l] %v (#f ##l #F)"
+
+static double run(spdlog::formatter& formatter, int count)
+{
+    spdlog::details::log_msg msg(spdlog::level::info);
+    msg.logger_name = "bench";
+    msg.time = spdlog::details::os::now();
+    msg.a_msg = spdlog::details::add_msg(__FILE__, __FUNCTION__, __LINE__);
+    msg.raw << "hello world " << 42;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        msg.time += std::chrono::microseconds(1);
+        msg.formatted.clear();
+        formatter.format(msg);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration_cast< std::chrono::duration< double, std::nano > >(elapsed).count() / count;
+}
+
+int main(int argc, char* argv[])
+{
+    int count = argc > 1 ? std::atoi(argv[1]) : 2000000;
+
+    spdlog::pattern_formatter runtime_formatter(BENCH_PATTERN);
+    SPDLOG_STATIC_PATTERN(BENCH_PATTERN) static_formatter;
+    run(runtime_formatter, count / 10);
+    run(static_formatter, count / 10);
+
+    std::printf("pattern: %s\n", BENCH_PATTERN);
+    std::printf("pattern_formatter:        %6.1f ns/msg\n", run(runtime_formatter, count));
+    std::printf("static_pattern_formatter: %6.1f ns/msg\n", run(static_formatter, count));
+    return 0;
+}
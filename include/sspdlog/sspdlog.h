@@ -12,10 +12,33 @@ void set_custom_sspdlog_config_file(const std::string &filename);
 
 void close_colored_log(bool if_colored = false);
 
+// flush all loggers, async ones write every message logged so far before flushing their sinks.
+// return false if async loggers were not flushed within wait_timeout (zero: only request the flush).
+bool flush_all_logs(const std::chrono::milliseconds &wait_timeout = std::chrono::milliseconds::max());
+
+// one line of queue counters per async logger, like:
+// root_logger: enqueued 120, dequeued 118, dropped 0, blocked 3, depth 2/2048, high water 1024, segments 1, wait us <8: 2, <16: 1
+// (wait us: blocked enqueues by wait time in microseconds), then the bytes queued in all of them:
+// async memory: 5210 bytes in use
+std::string dump_async_log_stats();
+
+// for async loggers with *_poll_mode = 1, which have no worker thread: register poll_fd() (an eventfd,
+// -1 if not supported) in the event loop, it gets readable when messages are queued. drain() then writes
+// up to max_messages of them, for at most about max_time, in the calling thread, and returns how many.
+int poll_fd();
+size_t drain(size_t max_messages = std::numeric_limits< size_t >::max(),
+             const std::chrono::microseconds &max_time = std::chrono::microseconds::max());
+
 }
 
 #define SSPDLOGGER_INSTANCE sspdlog::Sspdlogger::Instance()
-#define SSPD_LOG_LINE_INFO spdlog::details::add_msg(__FILE__, __FUNCTION__, __LINE__)
+// no copy of __FILE__ and __FUNCTION__, the #f part of __FILE__ is found by the compiler
+// (see SPDLOG_FILE_PREFIX in tweakme.h)
+#define SSPD_LOG_LINE_INFO spdlog::details::add_msg::call_site(__FILE__, \
+    std::integral_constant< size_t, spdlog::details::file_base_offset(__FILE__) >::value, __FUNCTION__, __LINE__)
+// a formatter for a pattern fixed at build time, parsed by the compiler instead of at each message:
+// logger->set_formatter(SSPD_STATIC_PATTERN("[%Y-%m-%d %H:%M:%S.%e] [%l] %v"));
+#define SSPD_STATIC_PATTERN(pattern) std::make_shared< SPDLOG_STATIC_PATTERN(pattern) >()
 
 #define SSPD_LOG_DEBUG_F(...)    SSPDLOGGER_INSTANCE->GetSpdLogger(sspdlog::DEFAULT_LOGGER_NAME)->debug(SSPD_LOG_LINE_INFO, __VA_ARGS__)
 #define SSPD_LOG_INFO_F(...)     SSPDLOGGER_INSTANCE->GetSpdLogger(sspdlog::DEFAULT_LOGGER_NAME)->info(SSPD_LOG_LINE_INFO, __VA_ARGS__)
@@ -11,12 +11,42 @@ namespace sspdlog
 
 const char SUBSTITUTE_KEY[] = "*";
 const char LOGGER_NAMES_KEY[] = "custom_logger_names";
+const char CRASH_HANDLER_KEY[] = "crash_handler";
+const char FORK_HANDLER_KEY[] = "fork_handler";
+const char ASYNC_MEMORY_BUDGET_KEY[] = "async_memory_budget";
+const char ASYNC_SHARED_WRITER_KEY[] = "async_shared_writer";
+const char DAEMON_SHM_NAME_KEY[] = "daemon_shm_name";
+const char DAEMON_QUEUE_SIZE_KEY[] = "daemon_queue_size";
+const char DAEMON_RECORD_SIZE_KEY[] = "daemon_record_size";
+const char DAEMON_SHM_MODE_KEY[] = "daemon_shm_mode";
 const char LOGGER_ASYNC_KEY[] = "*_async";
+const char LOGGER_DAEMON_KEY[] = "*_daemon";
 const char LOGGER_LEVEL_KEY[] = "*_level";
 const char LOGGER_FORMAT_KEY[] = "*_format";
+const char LOGGER_TIMEZONE_KEY[] = "*_timezone";
+const char LOGGER_SANITIZE_KEY[] = "*_sanitize";
 const char LOGGER_SINKS_KEY[] = "*_sinks";
+const char LOGGER_OVERFLOW_POLICY_KEY[] = "*_overflow_policy";
+const char LOGGER_OVERFLOW_TIMEOUT_KEY[] = "*_overflow_timeout_ms";
+const char LOGGER_DISCARD_LEVEL_KEY[] = "*_discard_level";
+const char LOGGER_PRIORITY_LEVEL_KEY[] = "*_priority_level";
+const char LOGGER_DROP_REPORT_INTERVAL_KEY[] = "*_drop_report_interval_ms";
+const char LOGGER_SHED_SAMPLE_RATE_KEY[] = "*_shed_sample_rate";
+const char LOGGER_SHED_WRITE_LATENCY_KEY[] = "*_shed_write_latency_us";
+const char LOGGER_QUEUE_SIZE_KEY[] = "*_queue_size";
+const char LOGGER_QUEUE_SEGMENTS_KEY[] = "*_queue_segments";
+const char LOGGER_FLUSH_INTERVAL_KEY[] = "*_flush_interval_ms";
+const char LOGGER_FORMATTER_THREADS_KEY[] = "*_formatter_threads";
+const char LOGGER_POLL_MODE_KEY[] = "*_poll_mode";
+const char LOGGER_PROFILE_KEY[] = "*_profile";
+const char LOGGER_NUMA_SHARDS_KEY[] = "*_numa_shards";
+const char LOGGER_WORKER_CPUS_KEY[] = "*_worker_cpus";
+const char LOGGER_WORKER_SCHED_KEY[] = "*_worker_sched";
+const char LOGGER_WORKER_NAME_KEY[] = "*_worker_name";
 
 const char SINK_KEY[] = "_sink";
+const char SINK_FORMAT_KEY[] = "*_sink_format";
+const char SINK_TIMEZONE_KEY[] = "*_sink_timezone";
 const char CONSOLE_SINK_KEY[] = "console_sink";
 const char FILE_SINK_KEY[] = "file_sink";
 const char FILE_DAILY_SINK_KEY[] = "file_daily_sink";
@@ -24,12 +54,39 @@ const char FILE_FULL_NAME_KEY[] = "*_full_name";
 const char FILE_SIZE_KEY[] = "*_size";
 const char FILE_ROTATE_NUM_KEY[] = "*_rotate_num";
 const char FILE_FORCE_FLUSH_KEY[] = "*_force_flush";
+const char FILE_CHILD_PID_SUFFIX_KEY[] = "*_child_pid_suffix";
 
 const char LEVEL_NAME_DEBUG[] = "debug";
 const char LEVEL_NAME_INFO[] = "info";
 const char LEVEL_NAME_WARNING[] = "warning";
 const char LEVEL_NAME_ERROR[] = "error";
 const char LEVEL_NAME_FATAL[] = "critical";
+const char LEVEL_NAME_OFF[] = "off";
+
+const char OVERFLOW_POLICY_BLOCK_RETRY[] = "block_retry";
+const char OVERFLOW_POLICY_DISCARD[] = "discard_log_msg";
+const char OVERFLOW_POLICY_OVERWRITE_OLDEST[] = "overwrite_oldest";
+const char OVERFLOW_POLICY_BLOCK_TIMEOUT[] = "block_timeout";
+const char OVERFLOW_POLICY_DISCARD_BELOW_LEVEL[] = "discard_below_level";
+const char OVERFLOW_POLICY_ADAPTIVE[] = "adaptive";
+
+const char FORMAT_JSON[] = "json";
+
+const char TIMEZONE_LOCAL[] = "local";
+const char TIMEZONE_UTC[] = "utc";
+
+const char SANITIZE_NONE[] = "none";
+const char SANITIZE_ESCAPE[] = "escape";
+const char SANITIZE_REPLACE[] = "replace";
+
+const char PROFILE_DEFAULT[] = "default";
+const char PROFILE_LOW_LATENCY[] = "low_latency";
+
+const char SCHED_POLICY_OTHER[] = "other";
+const char SCHED_POLICY_BATCH[] = "batch";
+const char SCHED_POLICY_IDLE[] = "idle";
+const char SCHED_POLICY_FIFO[] = "fifo";
+const char SCHED_POLICY_RR[] = "rr";
 
 const char DEFAULT_CONF_FILE[] = "sspdlog.conf";
 const char DEFAULT_LOGGER_NAME[] = "root_logger";
@@ -37,20 +94,52 @@ const char DEFAULT_FILE_SINK_NAME[] = "file";
 const char DEFAULT_FILE_DAILY_SINK_NAME[] = "file_daily";
 const std::map< std::string, std::string > CONFIG_MAP_DEFAULT = {
     { LOGGER_NAMES_KEY, "" },
+    { CRASH_HANDLER_KEY, "0" },
+    { FORK_HANDLER_KEY, "0" },
+    { ASYNC_MEMORY_BUDGET_KEY, "0" },
+    { ASYNC_SHARED_WRITER_KEY, "0" },
+    { DAEMON_SHM_NAME_KEY, "/sspdlog" },
+    { DAEMON_QUEUE_SIZE_KEY, "65536" },
+    { DAEMON_RECORD_SIZE_KEY, "512" },
+    { DAEMON_SHM_MODE_KEY, "0600" },
     { std::string(DEFAULT_LOGGER_NAME) + "_async", "0" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_daemon", "0" },
     { std::string(DEFAULT_LOGGER_NAME) + "_level", LEVEL_NAME_DEBUG },
     { std::string(DEFAULT_LOGGER_NAME) + "_format", "[%Y-%m-%d %H:%M:%S.%e] [%l] %v (#f ##l #F)" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_timezone", TIMEZONE_LOCAL },
+    { std::string(DEFAULT_LOGGER_NAME) + "_sanitize", SANITIZE_NONE },
     { std::string(DEFAULT_LOGGER_NAME) + "_sinks", "console,file" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_overflow_policy", OVERFLOW_POLICY_BLOCK_RETRY },
+    { std::string(DEFAULT_LOGGER_NAME) + "_overflow_timeout_ms", "100" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_discard_level", LEVEL_NAME_WARNING },
+    { std::string(DEFAULT_LOGGER_NAME) + "_priority_level", LEVEL_NAME_OFF },
+    { std::string(DEFAULT_LOGGER_NAME) + "_drop_report_interval_ms", "10000" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_shed_sample_rate", "10" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_shed_write_latency_us", "1000" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_queue_size", "1024" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_queue_segments", "0" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_flush_interval_ms", "0" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_formatter_threads", "0" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_poll_mode", "0" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_profile", PROFILE_DEFAULT },
+    { std::string(DEFAULT_LOGGER_NAME) + "_numa_shards", "0" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_worker_cpus", "" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_worker_sched", "" },
+    { std::string(DEFAULT_LOGGER_NAME) + "_worker_name", "" },
     { CONSOLE_SINK_KEY, "Console" },
     { std::string(DEFAULT_FILE_SINK_NAME) + "_sink", "RotateFile" },
+    { std::string(DEFAULT_FILE_SINK_NAME) + "_sink_format", "" },
+    { std::string(DEFAULT_FILE_SINK_NAME) + "_sink_timezone", TIMEZONE_LOCAL },
     { std::string(DEFAULT_FILE_SINK_NAME) + "_full_name", "./defaultLog" },
     { std::string(DEFAULT_FILE_SINK_NAME) + "_size", "1048576" },
     { std::string(DEFAULT_FILE_SINK_NAME) + "_rotate_num", "3" },
     { std::string(DEFAULT_FILE_SINK_NAME) + "_force_flush", "1" },
+    { std::string(DEFAULT_FILE_SINK_NAME) + "_child_pid_suffix", "0" },
     { std::string(DEFAULT_FILE_DAILY_SINK_NAME) + "_sink", "TimeRotateFile" },
     { std::string(DEFAULT_FILE_DAILY_SINK_NAME) + "_full_name", "./default2Log" },
     { std::string(DEFAULT_FILE_DAILY_SINK_NAME) + "_rotate_num", "3" },
-    { std::string(DEFAULT_FILE_DAILY_SINK_NAME) + "_force_flush", "1" }
+    { std::string(DEFAULT_FILE_DAILY_SINK_NAME) + "_force_flush", "1" },
+    { std::string(DEFAULT_FILE_DAILY_SINK_NAME) + "_child_pid_suffix", "0" }
 };
 
 class SspdlogConfig
@@ -70,6 +159,10 @@ public:
                 throw SspdlogInitError("ERROR GET CONFIG FROM CURRENT SSPDLOG CONFIG FOR KEY:" + key);
         } 
     };
+    bool HasConfig(const std::string &key) const
+    {
+        return _config_map.count(key) != 0;
+    }
     // add or modify configs described in 'conf', leave others (no deletes)
     void UpdateConfig(const std::map< std::string, std::string > &conf);
     // replace configs with values from 'conf', but don't delete values which are default ones
@@ -78,6 +171,8 @@ public:
     // file like this (the result is as the default one):
     /*
     custom_logger_names =   ""
+    crash_handler       =   0
+    async_memory_budget =   0
     root_logger_async   =   0
     root_logger_level   =   "debug"
     root_logger_format  =   "[%Y-%m-%d %H:%M:%S.%e]-[%l]- %v (#f ##l #F)"
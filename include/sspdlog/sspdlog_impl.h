@@ -1,6 +1,8 @@
 #ifndef SSPDLOG_IMPL_H
 #define SSPDLOG_IMPL_H
 
+#include <sstream>
+
 namespace sspdlog {
 
 inline void set_custom_sspdlog_config(const std::shared_ptr< std::map< std::string, std::string > > &conf, bool clear_old_config)
@@ -18,6 +20,83 @@ inline void close_colored_log(bool if_colored)
     spdlog::close_colored_log(if_colored);
 }
 
+inline bool flush_all_logs(const std::chrono::milliseconds &wait_timeout)
+{
+    std::vector< std::shared_ptr< spdlog::async_logger > > async_loggers;
+    spdlog::apply_all([&async_loggers](std::shared_ptr< spdlog::logger > l) {
+        auto async_l = std::dynamic_pointer_cast< spdlog::async_logger >(l);
+        if (async_l)
+            async_loggers.push_back(async_l);
+        else
+            l->flush();
+    });
+
+    // enqueue all flush markers first, so the async loggers flush in parallel
+    for (auto &l : async_loggers)
+        l->flush(std::chrono::milliseconds::zero());
+    if (wait_timeout == std::chrono::milliseconds::zero())
+        return async_loggers.empty();
+
+    bool flushed = true;
+    auto start = std::chrono::steady_clock::now();
+    for (auto &l : async_loggers) {
+        auto left = wait_timeout;
+        if (wait_timeout != std::chrono::milliseconds::max()) {
+            left -= std::chrono::duration_cast< std::chrono::milliseconds >(std::chrono::steady_clock::now() - start);
+            if (left <= std::chrono::milliseconds::zero())
+                left = std::chrono::milliseconds(1);
+        }
+        flushed = l->flush(left) && flushed;
+    }
+    return flushed;
+}
+
+inline int poll_fd()
+{
+    return spdlog::async_poll_fd();
+}
+
+inline size_t drain(size_t max_messages, const std::chrono::microseconds &max_time)
+{
+    return spdlog::drain_async(max_messages, max_time);
+}
+
+inline std::string dump_async_log_stats()
+{
+    std::ostringstream out;
+    spdlog::apply_all([&out](std::shared_ptr< spdlog::logger > l) {
+        auto async_l = std::dynamic_pointer_cast< spdlog::async_logger >(l);
+        if (!async_l)
+            return;
+        auto stats = async_l->stats();
+        out << l->name() << ": enqueued " << stats.enqueued << ", dequeued " << stats.dequeued
+            << ", dropped " << stats.dropped << ", blocked " << stats.blocked
+            << ", depth " << stats.depth << "/" << stats.capacity << ", high water " << stats.high_water
+            << ", segments " << stats.segments;
+        if (stats.shed || stats.shed_stage)
+            out << ", shed " << stats.shed << " (stage " << stats.shed_stage << ")";
+        if (stats.memory_locked)
+            out << ", memory locked";
+        if (stats.shards > 1)
+            out << ", shards " << stats.shards;
+        if (stats.blocked)
+            out << ", wait us";
+        const char *sep = " ";
+        for (size_t i = 0; i < spdlog::async_stats::wait_buckets; i++) {
+            if (!stats.wait_us[i])
+                continue;
+            if (i == spdlog::async_stats::wait_buckets - 1)
+                out << sep << ">=" << (1ull << (i - 1)) << ": " << stats.wait_us[i];
+            else
+                out << sep << "<" << (1ull << i) << ": " << stats.wait_us[i];
+            sep = ", ";
+        }
+        out << std::endl;
+    });
+    out << "async memory: " << spdlog::async_memory_in_use() << " bytes in use" << std::endl;
+    return out.str();
+}
+
 }
 
 #endif
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <memory>
 #include <set>
 #include <chrono>
+#include <functional>
 #include "sspdlog_config.h"
 #include "sspdlog_errors.h"
 #include <spdlog/spdlog.h>
@@ -115,6 +116,20 @@ protected:
     virtual std::vector< spdlog::sink_ptr > LoadSinks(const std::set< std::string > &sink_names,
                                                       const std::shared_ptr< SspdlogConfig > &conf);
 
+    // callback run by the worker thread of async logger 'logger_name' upon start,
+    // setting its cpu affinity, scheduling policy and name from the config
+    virtual std::function< void() > LoadWorkerWarmup(const std::string &logger_name,
+                                                     const std::shared_ptr< SspdlogConfig > &conf);
+
+    // config of the logger 'logger_name' for 'key' (like "*_level"), falling back to the root logger one
+    static std::string GetLoggerConfig(const std::shared_ptr< SspdlogConfig > &conf, const char *key,
+                                       const std::string &logger_name);
+
+    // formatter for a format ("json" or a pattern) and a time zone ("local", "utc" or like "+08:00"),
+    // the same object for the same ones, so that loggers and sinks sharing a format render it once per message
+    static spdlog::formatter_ptr MakeFormatter(const std::string &format, const std::string &time_zone);
+    static spdlog::time_zone GetTimeZone(const std::string &time_zone);
+
     Sspdlogger(const Sspdlogger &) = delete;
     const Sspdlogger &operator=(const Sspdlogger &) = delete;
 
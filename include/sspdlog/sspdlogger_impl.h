@@ -2,7 +2,10 @@
 #define SSPDLOGGER_IMPL_H
 
 #include <set>
+#include <map>
 #include <cstring>
+#include <cctype>
+#include <algorithm>
 #ifdef __linux__
 #include <unistd.h>
 #include <libgen.h>
@@ -56,41 +59,268 @@ inline void Sspdlogger::Init()
         return result;
     };
 
+    // level names in config are lower case ("warning"), spdlog ones are upper case ("WARNING")
     auto get_level_enum = [](const std::string &level_name) -> spdlog::level::level_enum {
         for (int i = 0; i < spdlog::level::level_enum::off + 1; i++){
-            if (!std::strcmp(spdlog::level::level_names[i], level_name.c_str()))
+            const char *name = spdlog::level::level_names[i];
+            if (std::strlen(name) == level_name.size() &&
+                std::equal(level_name.begin(), level_name.end(), name,
+                           [](char a, char b) { return std::toupper(a) == std::toupper(b); }))
                 return static_cast< spdlog::level::level_enum >(i);
         }
         return spdlog::level::debug;
     };
 
+    auto get_overflow_policy = [](const std::string &policy_name) -> spdlog::async_overflow_policy {
+        if (policy_name == OVERFLOW_POLICY_BLOCK_RETRY)
+            return spdlog::async_overflow_policy::block_retry;
+        if (policy_name == OVERFLOW_POLICY_DISCARD)
+            return spdlog::async_overflow_policy::discard_log_msg;
+        if (policy_name == OVERFLOW_POLICY_OVERWRITE_OLDEST)
+            return spdlog::async_overflow_policy::overwrite_oldest;
+        if (policy_name == OVERFLOW_POLICY_BLOCK_TIMEOUT)
+            return spdlog::async_overflow_policy::block_timeout;
+        if (policy_name == OVERFLOW_POLICY_DISCARD_BELOW_LEVEL)
+            return spdlog::async_overflow_policy::discard_below_level;
+        if (policy_name == OVERFLOW_POLICY_ADAPTIVE)
+            return spdlog::async_overflow_policy::adaptive;
+        throw SspdlogInitError("UNKNOWN ASYNC OVERFLOW POLICY IN SSPDLOG CONFIG: " + policy_name);
+    };
+
+    auto get_sanitize_mode = [](const std::string &mode_name) -> spdlog::sanitize_mode {
+        if (mode_name == SANITIZE_NONE)
+            return spdlog::sanitize_mode::none;
+        if (mode_name == SANITIZE_ESCAPE)
+            return spdlog::sanitize_mode::escape;
+        if (mode_name == SANITIZE_REPLACE)
+            return spdlog::sanitize_mode::replace;
+        throw SspdlogInitError("UNKNOWN SANITIZE MODE IN SSPDLOG CONFIG: " + mode_name);
+    };
+
     // load all loggers
     auto conf = _conf;
+    auto get_logger_config = [&conf](const char *key, const std::string &name) -> std::string {
+        return Sspdlogger::GetLoggerConfig(conf, key, name);
+    };
+    try{
+        spdlog::set_async_memory_budget(std::stoul(conf->GetCurrentConfig(ASYNC_MEMORY_BUDGET_KEY)));
+    }
+    catch (const std::exception &){
+        throw SspdlogInitError("ERROR READ SSPDLOG CONFIG FOR ASYNC MEMORY BUDGET");
+    }
     auto all_loggers = parse_names(conf->GetCurrentConfig(LOGGER_NAMES_KEY));
     all_loggers.insert(DEFAULT_LOGGER_NAME);
+
+    // daemon loggers hand their messages to the sspdlogd process through a shared memory ring,
+    // which formats and writes them with this same config, so they load no sinks here
+    auto daemon_shm_name = conf->GetCurrentConfig(DAEMON_SHM_NAME_KEY);
+    size_t daemon_queue_size, daemon_record_size, daemon_shm_mode;
+    try{
+        daemon_queue_size = std::stoul(conf->GetCurrentConfig(DAEMON_QUEUE_SIZE_KEY));
+        daemon_record_size = std::stoul(conf->GetCurrentConfig(DAEMON_RECORD_SIZE_KEY));
+        daemon_shm_mode = std::stoul(conf->GetCurrentConfig(DAEMON_SHM_MODE_KEY), nullptr, 8);
+    }
+    catch (const std::exception &){
+        throw SspdlogInitError("ERROR READ SSPDLOG CONFIG FOR DAEMON");
+    }
+
+    // a sink shared by several async loggers gets one writer owning it, instead of their workers contending
+    // on the sink's lock and interleaving their lines
+    std::map< std::string, std::vector< spdlog::sink_ptr > > logger_sinks;
+    std::map< spdlog::sink_ptr, int > async_users;
+    for (auto &l : all_loggers){
+        if (get_logger_config(LOGGER_DAEMON_KEY, l) == "1")
+            continue;
+        auto &sinks = logger_sinks[l] = this->LoadSinks(parse_names(get_logger_config(LOGGER_SINKS_KEY, l)), conf);
+        if (get_logger_config(LOGGER_ASYNC_KEY, l) == "1")
+            for (auto &s : sinks)
+                async_users[s]++;
+    }
+    std::map< spdlog::sink_ptr, spdlog::sink_ptr > shared_writers;
+    if (conf->GetCurrentConfig(ASYNC_SHARED_WRITER_KEY) == "1")
+        for (auto &u : async_users)
+            if (u.second > 1)
+                shared_writers[u.first] = std::make_shared< spdlog::sinks::shared_writer_sink >(u.first);
+
     for (auto &l : all_loggers){
-        auto level = conf->GetCurrentConfig(std::string(LOGGER_LEVEL_KEY).replace(0, std::strlen(SUBSTITUTE_KEY), l),
-            std::string(LOGGER_LEVEL_KEY).replace(0, std::strlen(SUBSTITUTE_KEY), DEFAULT_LOGGER_NAME));
-        auto format = conf->GetCurrentConfig(std::string(LOGGER_FORMAT_KEY).replace(0, std::strlen(SUBSTITUTE_KEY), l),
-            std::string(LOGGER_FORMAT_KEY).replace(0, std::strlen(SUBSTITUTE_KEY), DEFAULT_LOGGER_NAME));
-        auto sink_names = conf->GetCurrentConfig(std::string(LOGGER_SINKS_KEY).replace(0, std::strlen(SUBSTITUTE_KEY), l),
-            std::string(LOGGER_SINKS_KEY).replace(0, std::strlen(SUBSTITUTE_KEY), DEFAULT_LOGGER_NAME));
-        auto sinks = this->LoadSinks(parse_names(sink_names), conf);
-        auto asyn = conf->GetCurrentConfig(std::string(LOGGER_ASYNC_KEY).replace(0, std::strlen(SUBSTITUTE_KEY), l),
-            std::string(LOGGER_ASYNC_KEY).replace(0, std::strlen(SUBSTITUTE_KEY), DEFAULT_LOGGER_NAME));
+        auto level = get_logger_config(LOGGER_LEVEL_KEY, l);
+        auto format = get_logger_config(LOGGER_FORMAT_KEY, l);
+        auto &sinks = logger_sinks[l];
+        auto asyn = get_logger_config(LOGGER_ASYNC_KEY, l);
 
         std::shared_ptr< spdlog::logger > logger;
-        if (asyn == "1"){
-            const int one_m_size = 1024;
+        if (get_logger_config(LOGGER_DAEMON_KEY, l) == "1"){
+            if (asyn == "1")
+                throw SspdlogInitError("SSPDLOG DAEMON LOGGER CAN'T BE ASYNC FOR LOGGER " + l);
+            if (daemon_queue_size < 2 || (daemon_queue_size & (daemon_queue_size - 1)))
+                throw SspdlogInitError("SSPDLOG DAEMON QUEUE SIZE MUST BE A POWER OF TWO");
+            logger = std::make_shared< spdlog::shm_logger >(l, daemon_shm_name, daemon_queue_size, daemon_record_size,
+                static_cast< unsigned >(daemon_shm_mode));
+        }
+        else if (asyn == "1"){
+            for (auto &s : sinks)
+                if (shared_writers.count(s))
+                    s = shared_writers[s];
+            size_t queue_size;
+            std::chrono::milliseconds flush_interval;
+            auto policy = get_overflow_policy(get_logger_config(LOGGER_OVERFLOW_POLICY_KEY, l));
+            spdlog::async_options options;
+            try{
+                queue_size = std::stoul(get_logger_config(LOGGER_QUEUE_SIZE_KEY, l));
+                options.max_queue_segments = std::stoul(get_logger_config(LOGGER_QUEUE_SEGMENTS_KEY, l));
+                flush_interval = std::chrono::milliseconds(std::stoi(get_logger_config(LOGGER_FLUSH_INTERVAL_KEY, l)));
+                options.block_timeout = std::chrono::milliseconds(std::stoi(get_logger_config(LOGGER_OVERFLOW_TIMEOUT_KEY, l)));
+                options.drop_report_interval = std::chrono::milliseconds(std::stoi(get_logger_config(LOGGER_DROP_REPORT_INTERVAL_KEY, l)));
+                options.formatter_threads = std::stoul(get_logger_config(LOGGER_FORMATTER_THREADS_KEY, l));
+                options.shed_sample_rate = std::stoul(get_logger_config(LOGGER_SHED_SAMPLE_RATE_KEY, l));
+                options.shed_write_latency = std::chrono::microseconds(std::stoi(get_logger_config(LOGGER_SHED_WRITE_LATENCY_KEY, l)));
+            }
+            catch (const std::exception &){
+                throw SspdlogInitError("ERROR READ SSPDLOG CONFIG FOR ASYNC LOGGER " + l);
+            }
+            if (queue_size < 2 || (queue_size & (queue_size - 1)))
+                throw SspdlogInitError("SSPDLOG ASYNC QUEUE SIZE MUST BE A POWER OF TWO FOR LOGGER " + l);
+            if (!options.shed_sample_rate)
+                throw SspdlogInitError("SSPDLOG SHED SAMPLE RATE MUST BE AT LEAST 1 FOR LOGGER " + l);
+            options.discard_level = get_level_enum(get_logger_config(LOGGER_DISCARD_LEVEL_KEY, l));
+            options.priority_level = get_level_enum(get_logger_config(LOGGER_PRIORITY_LEVEL_KEY, l));
+            options.poll_mode = get_logger_config(LOGGER_POLL_MODE_KEY, l) == "1";
+            if (options.poll_mode && options.formatter_threads)
+                throw SspdlogInitError("SSPDLOG POLL MODE CAN'T USE FORMATTER THREADS FOR LOGGER " + l);
+            options.numa_shards = get_logger_config(LOGGER_NUMA_SHARDS_KEY, l) == "1";
+            if (options.numa_shards && (options.poll_mode || options.formatter_threads))
+                throw SspdlogInitError("SSPDLOG NUMA SHARDS CAN'T BE USED WITH POLL MODE OR FORMATTER THREADS FOR LOGGER " + l);
+            auto profile = get_logger_config(LOGGER_PROFILE_KEY, l);
+            if (profile == PROFILE_LOW_LATENCY){
+                if (options.max_queue_segments)
+                    throw SspdlogInitError("SSPDLOG LOW LATENCY PROFILE NEEDS A BOUNDED QUEUE FOR LOGGER " + l);
+                options.lock_memory = true;
+                options.huge_pages = true;
+                options.warm_up = true;
+            }
+            else if (profile != PROFILE_DEFAULT)
+                throw SspdlogInitError("UNKNOWN PROFILE IN SSPDLOG CONFIG: " + profile);
             logger = std::make_shared< spdlog::async_logger >(l, std::begin(sinks), std::end(sinks),
-                one_m_size, spdlog::async_overflow_policy::block_retry, nullptr, std::chrono::milliseconds::zero());
+                queue_size, policy, this->LoadWorkerWarmup(l, conf), flush_interval, options);
         }
         else
             logger = std::make_shared< spdlog::logger >(l, std::begin(sinks), std::end(sinks));
         logger->set_level(get_level_enum(level));
-        logger->set_pattern(format);
+        logger->set_sanitize(get_sanitize_mode(get_logger_config(LOGGER_SANITIZE_KEY, l)));
+        logger->set_formatter(MakeFormatter(format, get_logger_config(LOGGER_TIMEZONE_KEY, l)));
         spdlog::register_logger(logger);
     }
+
+    // drain the async queues on a fatal signal, installed after the loggers so they are all covered
+    if (conf->GetCurrentConfig(CRASH_HANDLER_KEY) == "1")
+        spdlog::install_crash_handler();
+    if (conf->GetCurrentConfig(FORK_HANDLER_KEY) == "1")
+        spdlog::install_fork_handler();
+}
+
+inline std::string Sspdlogger::GetLoggerConfig(const std::shared_ptr< SspdlogConfig > &conf, const char *key,
+                                                const std::string &logger_name)
+{
+    return conf->GetCurrentConfig(std::string(key).replace(0, std::strlen(SUBSTITUTE_KEY), logger_name),
+        std::string(key).replace(0, std::strlen(SUBSTITUTE_KEY), DEFAULT_LOGGER_NAME));
+}
+
+inline std::function< void() > Sspdlogger::LoadWorkerWarmup(const std::string &logger_name,
+                                                            const std::shared_ptr< SspdlogConfig > &conf)
+{
+    // cpus like "2,3" or "2-3", empty to leave the affinity as is
+    std::vector< int > cpus;
+    auto cpus_conf = GetLoggerConfig(conf, LOGGER_WORKER_CPUS_KEY, logger_name);
+    // scheduling like "fifo:10" (policy:priority), empty to leave the scheduling as is
+    auto sched_conf = GetLoggerConfig(conf, LOGGER_WORKER_SCHED_KEY, logger_name);
+    auto name = GetLoggerConfig(conf, LOGGER_WORKER_NAME_KEY, logger_name);
+    int sched_policy = -1, sched_priority = 0;
+    try{
+        std::string::size_type cur_p = 0;
+        while (cur_p < cpus_conf.size()) {
+            auto pos = cpus_conf.find(',', cur_p);
+            if (pos == std::string::npos)
+                pos = cpus_conf.size();
+            auto range = cpus_conf.substr(cur_p, pos - cur_p);
+            auto dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            if (first < 0 || last < first)
+                throw std::invalid_argument(range);
+            for (int cpu = first; cpu <= last; cpu++)
+                cpus.push_back(cpu);
+            cur_p = pos + 1;
+        }
+
+        if (sched_conf != "") {
+            auto colon = sched_conf.find(':');
+            auto policy_name = sched_conf.substr(0, colon);
+            if (colon != std::string::npos)
+                sched_priority = std::stoi(sched_conf.substr(colon + 1));
+#ifdef __linux__
+            if (policy_name == SCHED_POLICY_OTHER)
+                sched_policy = SCHED_OTHER;
+            else if (policy_name == SCHED_POLICY_BATCH)
+                sched_policy = SCHED_BATCH;
+            else if (policy_name == SCHED_POLICY_IDLE)
+                sched_policy = SCHED_IDLE;
+            else if (policy_name == SCHED_POLICY_FIFO)
+                sched_policy = SCHED_FIFO;
+            else if (policy_name == SCHED_POLICY_RR)
+                sched_policy = SCHED_RR;
+            else
+#endif
+                throw std::invalid_argument(policy_name);
+        }
+    }
+    catch (const std::exception &){
+        throw SspdlogInitError("ERROR READ SSPDLOG CONFIG FOR WORKER THREAD OF LOGGER " + logger_name);
+    }
+
+    if (cpus.empty() && sched_policy < 0 && name == "")
+        return nullptr;
+    // the worker keeps logging even if the system refuses a setting (e.g. real time scheduling without privileges)
+    return [cpus, sched_policy, sched_priority, name]() {
+        if (!cpus.empty())
+            spdlog::details::os::set_thread_affinity(cpus);
+        if (sched_policy >= 0)
+            spdlog::details::os::set_thread_scheduling(sched_policy, sched_priority);
+        if (name != "")
+            spdlog::details::os::set_thread_name(name);
+    };
+}
+
+inline spdlog::time_zone Sspdlogger::GetTimeZone(const std::string &time_zone)
+{
+    if (time_zone == TIMEZONE_LOCAL)
+        return spdlog::time_zone();
+    if (time_zone == TIMEZONE_UTC)
+        return spdlog::time_zone::utc();
+    // a fixed offset like +08:00 or -05:30
+    auto digit = [&time_zone](size_t i) { return std::isdigit(static_cast< unsigned char >(time_zone[i])) != 0; };
+    if (time_zone.size() == 6 && (time_zone[0] == '+' || time_zone[0] == '-') && time_zone[3] == ':' &&
+        digit(1) && digit(2) && digit(4) && digit(5)){
+        int hours = (time_zone[1] - '0') * 10 + time_zone[2] - '0';
+        int minutes = (time_zone[4] - '0') * 10 + time_zone[5] - '0';
+        if (hours <= 14 && minutes < 60)
+            return spdlog::time_zone::fixed((time_zone[0] == '-' ? -1 : 1) * (hours * 60 + minutes));
+    }
+    throw SspdlogInitError("UNKNOWN TIMEZONE IN SSPDLOG CONFIG: " + time_zone);
+}
+
+inline spdlog::formatter_ptr Sspdlogger::MakeFormatter(const std::string &format, const std::string &time_zone)
+{
+    static std::mutex formatters_mtx;
+    static std::map< std::pair< std::string, std::string >, spdlog::formatter_ptr > formatters;
+    std::lock_guard< std::mutex > lock(formatters_mtx);
+    auto &formatter = formatters[std::make_pair(format, time_zone)];
+    if (!formatter){
+        if (format == FORMAT_JSON)
+            formatter = std::make_shared< spdlog::json_formatter >(GetTimeZone(time_zone));
+        else
+            formatter = std::make_shared< spdlog::pattern_formatter >(format, GetTimeZone(time_zone));
+    }
+    return formatter;
 }
 
 inline std::vector< spdlog::sink_ptr > Sspdlogger::LoadSinks(const std::set< std::string > &sink_names,
@@ -101,6 +331,7 @@ inline std::vector< spdlog::sink_ptr > Sspdlogger::LoadSinks(const std::set< std
     std::vector< spdlog::sink_ptr > result;
     for (auto &s : sink_names) {
         auto name = s + SINK_KEY;
+        auto loaded = result.size();
         if (name == CONSOLE_SINK_KEY) {
 #ifdef _WIN32
 #include "windows.h"
@@ -193,6 +424,10 @@ inline std::vector< spdlog::sink_ptr > Sspdlogger::LoadSinks(const std::set< std
                                 throw;
                         }
                     }
+                    // prefork servers: each child writes to its own file, named after its pid
+                    if (conf->GetCurrentConfig(std::string(FILE_CHILD_PID_SUFFIX_KEY).replace(0, std::strlen(SUBSTITUTE_KEY), s),
+                        std::string(FILE_CHILD_PID_SUFFIX_KEY).replace(0, std::strlen(SUBSTITUTE_KEY), DEFAULT_FILE_SINK_NAME)) == "1")
+                        file_sink->set_child_pid_suffix(true);
                     file_sinks[filename] = file_sink;
                 }
                 else
@@ -260,6 +495,9 @@ inline std::vector< spdlog::sink_ptr > Sspdlogger::LoadSinks(const std::set< std
                                 throw;
                         }
                     }
+                    if (conf->GetCurrentConfig(std::string(FILE_CHILD_PID_SUFFIX_KEY).replace(0, std::strlen(SUBSTITUTE_KEY), s),
+                        std::string(FILE_CHILD_PID_SUFFIX_KEY).replace(0, std::strlen(SUBSTITUTE_KEY), DEFAULT_FILE_DAILY_SINK_NAME)) == "1")
+                        file_sink->set_child_pid_suffix(true);
                     file_sinks[filename] = file_sink;
                 }
                 else
@@ -269,6 +507,14 @@ inline std::vector< spdlog::sink_ptr > Sspdlogger::LoadSinks(const std::set< std
                 file_sink = file_sinks[file_sink_names[name]];
             result.push_back(file_sink);
         }
+
+        // a format of its own, instead of the logger's, only if set for this very sink
+        auto format_key = std::string(SINK_FORMAT_KEY).replace(0, std::strlen(SUBSTITUTE_KEY), s);
+        auto timezone_key = std::string(SINK_TIMEZONE_KEY).replace(0, std::strlen(SUBSTITUTE_KEY), s);
+        auto sink_format = conf->HasConfig(format_key) ? conf->GetCurrentConfig(format_key) : "";
+        if (!sink_format.empty() && result.size() > loaded)
+            result.back()->set_formatter(MakeFormatter(sink_format,
+                conf->HasConfig(timezone_key) ? conf->GetCurrentConfig(timezone_key) : TIMEZONE_LOCAL));
     }
     return result;
 }
@@ -30,8 +30,9 @@
 //
 // Upon each log write the logger:
 //    1. Checks if its log level is enough to log the message
-//    2. Push a new copy of the message to a queue (or block the caller until space is available in the queue)
+//    2. Push a new copy of the message to a queue (or block the caller / discard a message according to the overflow policy)
 //    3. will throw spdlog_ex upon log exceptions
+// Upon flush, the worker flushes the sinks once all messages logged before were written.
 // Upong destruction, logs all remaining messages in the queue before destructing..
 
 #include <chrono>
@@ -59,25 +60,47 @@ public:
                  size_t queue_size,
                  const async_overflow_policy overflow_policy =  async_overflow_policy::block_retry,
                  const std::function<void()>& worker_warmup_cb = nullptr,
-                 const std::chrono::milliseconds& flush_interval_ms = std::chrono::milliseconds::zero());
+                 const std::chrono::milliseconds& flush_interval_ms = std::chrono::milliseconds::zero(),
+                 const async_options& options = async_options());
 
     async_logger(const std::string& logger_name,
                  sinks_init_list sinks,
                  size_t queue_size,
                  const async_overflow_policy overflow_policy = async_overflow_policy::block_retry,
                  const std::function<void()>& worker_warmup_cb = nullptr,
-                 const std::chrono::milliseconds& flush_interval_ms = std::chrono::milliseconds::zero());
+                 const std::chrono::milliseconds& flush_interval_ms = std::chrono::milliseconds::zero(),
+                 const async_options& options = async_options());
 
     async_logger(const std::string& logger_name,
                  sink_ptr single_sink,
                  size_t queue_size,
                  const async_overflow_policy overflow_policy =  async_overflow_policy::block_retry,
                  const std::function<void()>& worker_warmup_cb = nullptr,
-                 const std::chrono::milliseconds& flush_interval_ms = std::chrono::milliseconds::zero());
+                 const std::chrono::milliseconds& flush_interval_ms = std::chrono::milliseconds::zero(),
+                 const async_options& options = async_options());
 
+    // flush() waits until every message logged before it was written and the sinks were flushed, for at most
+    // async_options::flush_timeout, and not at all from the worker thread (e.g. from a sink or flush_on()).
+    // flush(wait_timeout) waits at most wait_timeout and returns true if flushed in time (zero: only enqueue the flush, return false).
+    using logger::flush;
+    bool flush(const std::chrono::milliseconds& wait_timeout);
+
+    // number of messages discarded by the overflow policy, for one level or in total
+    size_t dropped(level::level_enum lvl) const;
+    size_t dropped() const;
+
+    // queue counters: enqueued, dequeued, dropped and blocked messages, depth, high-water mark and wait times
+    async_stats stats() const;
+
+    // poll mode (async_options::poll_mode) only: write up to max_messages queued messages in the calling
+    // thread, for at most about max_time, and return how many were written. see spdlog::drain_async().
+    size_t drain(size_t max_messages, const std::chrono::microseconds& max_time);
+    bool poll_mode() const;
+    bool pending() const;
 
 protected:
     void _log_msg(details::log_msg& msg) override;
+    void _flush() override;
     void _set_formatter(spdlog::formatter_ptr msg_formatter) override;
     void _set_pattern(const std::string& pattern) override;
 
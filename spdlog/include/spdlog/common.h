@@ -28,6 +28,7 @@
 #include <initializer_list>
 #include <chrono>
 #include <memory>
+#include <vector>
 
 //visual studio does not support noexcept yet
 #ifndef _MSC_VER
@@ -94,7 +95,128 @@ inline const char* to_short_str(spdlog::level::level_enum l)
 enum class async_overflow_policy
 {
     block_retry, // Block / yield / sleep until message can be enqueued
-    discard_log_msg // Discard the message it enqueue fails
+    discard_log_msg, // Discard the message it enqueue fails
+    overwrite_oldest, // Discard the oldest queued message to make room for the new one
+    block_timeout, // Block like block_retry, but discard the message after async_options::block_timeout
+    discard_below_level, // Discard messages below async_options::discard_level, block for the others
+    adaptive // Sample down levels below warn while the worker can't keep up (see async_options), discard them if the queue is full, block for the others
+};
+
+//
+// Async logger tunables beside the queue size and the overflow policy.
+//
+struct async_options
+{
+    // how long block_timeout waits for room in the queue before discarding the message
+    std::chrono::milliseconds block_timeout = std::chrono::milliseconds(100);
+
+    // how long flush() with no timeout (and flush_on()) waits for the messages logged before to be written
+    std::chrono::milliseconds flush_timeout = std::chrono::seconds(10);
+
+    // discard_below_level never discards messages of this level or above
+    level::level_enum discard_level = level::warn;
+
+    // how often the worker reports discarded messages with a "N messages dropped" line (zero to stay silent)
+    std::chrono::milliseconds drop_report_interval = std::chrono::seconds(10);
+
+    // threads formatting messages in parallel ahead of the worker, which then only writes them to the sinks
+    // in logging order (zero for the worker to format the messages itself)
+    size_t formatter_threads = 0;
+
+    // messages of this level or above go to a separate lane, drained first by the worker and never discarded
+    // by the overflow policy (level::off, the default, for a single lane)
+    level::level_enum priority_level = level::off;
+
+    // zero for a queue of queue_size messages allocated up front, else a queue growing by segments of
+    // queue_size messages when needed, up to max_queue_segments of them (freed segments are kept for reuse)
+    size_t max_queue_segments = 0;
+
+    // adaptive policy: every shed_interval, the worker raises the shedding stage when the queue is at least
+    // shed_high_water full or sink writes took shed_write_latency per message on average, and lowers it
+    // once the queue is at most shed_low_water full. Stage 1 keeps 1 of shed_sample_rate trace and debug
+    // messages, stage 2 info ones too, stage 3 notice ones too.
+    std::chrono::milliseconds shed_interval = std::chrono::milliseconds(100);
+    std::chrono::microseconds shed_write_latency = std::chrono::microseconds(1000);
+    double shed_high_water = 0.75;
+    double shed_low_water = 0.25;
+    size_t shed_sample_rate = 10;
+
+    // no worker thread: the application writes the queued messages out with drain(), e.g. from its event
+    // loop when the poll fd (see spdlog::async_poll_fd()) gets readable. flush() and a full queue under
+    // the blocking policies drain in the calling thread. Can't be used with formatter_threads.
+    bool poll_mode = false;
+
+    // low latency: lock the queue memory in RAM (mlock), align it on transparent huge pages, and run the
+    // formatter once in the worker (and formatter threads) at start, so the first messages after startup
+    // don't take page faults. The memory options need a bounded queue (max_queue_segments 0).
+    bool lock_memory = false;
+    bool huge_pages = false;
+    bool warm_up = false;
+
+    // one queue and formatting thread (pinned to the node's cpus) per NUMA node, when there are several:
+    // producers enqueue into the queue of the node they run on, and the worker merges the formatted
+    // messages of all nodes by time. shard_cpus replaces the nodes found in /sys (a cpu in none of them
+    // goes to the first shard). Can't be used with formatter_threads or poll_mode.
+    bool numa_shards = false;
+    std::vector<std::vector<int>> shard_cpus;
+};
+
+//
+// Async logger queue counters, both lanes together (see async_logger::stats)
+//
+struct async_stats
+{
+    size_t enqueued = 0;    // queue entries so far, flush markers included
+    size_t dequeued = 0;
+    size_t dropped = 0;     // messages discarded by the overflow policy
+    size_t blocked = 0;     // enqueues which had to wait for room
+    size_t depth = 0;       // entries in the queue now
+    size_t high_water = 0;  // most entries seen in the queue
+    size_t capacity = 0;
+    size_t segments = 0;    // queue segments allocated (1 for a bounded queue)
+    size_t shed = 0;        // messages sampled out by the adaptive policy
+    int shed_stage = 0;     // current adaptive shedding stage (0: keeping all messages)
+    bool memory_locked = false; // the queue memory is locked in RAM (async_options::lock_memory)
+    size_t shards = 1;      // queues, one per NUMA node with async_options::numa_shards
+
+    // blocked enqueues by wait time: bucket 0 under 1us, bucket i from 2^(i-1)us up to 2^i us (the last one open)
+    static const size_t wait_buckets = 32;
+    size_t wait_us[wait_buckets] = {};
+};
+
+//
+// Time zone of the date and time flags of a pattern_formatter: local time (localtime_r(), following TZ),
+// or a fixed offset from UTC, converted to a date with integer arithmetic only, with no call into the
+// libc time zone code and its lock.
+//
+struct time_zone
+{
+    bool local = true;
+    int utc_minutes = 0;    // offset of a fixed time zone, east of UTC
+
+    static time_zone utc()
+    {
+        return fixed(0);
+    }
+
+    static time_zone fixed(int utc_minutes)
+    {
+        time_zone tz;
+        tz.local = false;
+        tz.utc_minutes = utc_minutes;
+        return tz;
+    }
+};
+
+
+// What a logger does with the control bytes (newlines and ANSI escapes included) and the invalid UTF-8
+// of its messages' text, which could forge log lines or break what parses the logs
+//
+enum class sanitize_mode
+{
+    none,       // log the text as is
+    escape,     // \n, \r and \t written as such, the other bytes as \xHH
+    replace     // each byte replaced with U+FFFD
 };
 
 
@@ -25,11 +25,50 @@
 // async log helper :
 // Process logs asynchronously using a back thread.
 //
+// The internal queue is bounded (preallocated), or with options.max_queue_segments grows by segments
+// of queue_size messages on demand, up to that many segments.
 // If the internal queue of log messages reaches its max size,
-// then the client call will block until there is more room.
+// then the client call will block until there is more room,
+// or the message is discarded according to the async_overflow_policy.
+// Discarded messages are counted per level and reported periodically by the back thread.
+// Blocked enqueues and their wait time, and the queue high-water mark are counted for stats().
+//
+// With the adaptive policy, the back thread watches the queue occupancy and the sink write time, and under
+// pressure samples down messages below warn, level by level, in the client threads. Each stage change
+// is logged with the number of messages shed since the previous one.
+//
+// The message data queued in all helpers is charged to one process wide memory budget. A message which
+// would exceed it is handled like one finding the queue full (priority lane messages are only counted).
+//
+// Messages of options.priority_level or above use a second queue (lane) of the same size, which the
+// back thread always drains first, and which always blocks when full. They may so be written before
+// lower level messages logged earlier. Flush and terminate markers use the normal lane, so they still
+// come after everything logged before them.
 //
 // If the back thread throws during logging, a spdlog::spdlog_ex exception
 // will be thrown in client's thread when tries to log the next message
+//
+// Flushing enqueues a flush marker, so the sinks get flushed by the back thread
+// only after every message logged before the flush was written to them.
+//
+// With options.formatter_threads, formatter threads dequeue and format the messages in parallel,
+// each into the reorder slot of its queue position, and the back thread writes the slots in order.
+//
+// With options.numa_shards on a NUMA machine, each node gets its own queue and a thread pinned on the node,
+// which allocates the queue (first touch) and formats the messages into its own ring of slots. Producers
+// enqueue into the queue of the node they run on, and the back thread merges the rings by message time.
+// Flush markers enter every queue in the same order, a flush completes once all shards passed it.
+//
+// With options.poll_mode there is no back thread: the application calls drain() from its own loop,
+// woken through the process wide poll fd, which gets readable when a message is enqueued in any of these
+// helpers. Flushes, and enqueues waiting for room, drain in the calling thread instead of waiting.
+//
+// Every helper is registered in a fixed lock free table, so a fatal signal handler
+// can write out the queued messages with crash_drain() (see crash_handler.h).
+//
+// Around fork(), the fork handler (see fork_handler.h) parks the back threads at a safe point with
+// prepare_fork(). The parent then resumes them, while the child, which has none of them, drops what
+// was queued (the parent writes it) and starts its own.
 
 #pragma once
 
@@ -37,12 +76,23 @@
 #include <thread>
 #include <atomic>
 #include <functional>
+#include <limits>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
 
 #include "../common.h"
 #include "../sinks/sink.h"
 #include "./mpmc_bounded_q.h"
+#include "./mpmc_segmented_q.h"
 #include "./log_msg.h"
 #include "./format.h"
+#include "./sink_dispatch.h"
 #include "os.h"
 
 
@@ -53,10 +103,22 @@ namespace details
 
 class async_log_helper
 {
+    // Async msg type, the back thread handles flush and terminate messages itself
+    enum class async_msg_type
+    {
+        log,
+        flush,
+        terminate,
+        discarded // reorder slot of a message discarded by overwrite_oldest
+    };
+
     // Async msg to move to/from the queue
     // Movable only. should never be copied
     struct async_msg
     {
+        async_msg_type msg_type = async_msg_type::log;
+        size_t flush_id = 0;
+        size_t payload = 0; // bytes charged to the memory budget while queued
         std::string logger_name;
         level::level_enum level;
         log_clock::time_point time;
@@ -68,15 +130,22 @@ class async_log_helper
         ~async_msg() = default;
 
 async_msg(async_msg&& other) SPDLOG_NOEXCEPT:
-        logger_name(std::move(other.logger_name)),
+        msg_type(other.msg_type),
+                 flush_id(other.flush_id),
+                 payload(other.payload),
+                 logger_name(std::move(other.logger_name)),
                     level(std::move(other.level)),
                     time(std::move(other.time)),
+                    thread_id(other.thread_id),
                     txt(std::move(other.txt)),
                     a_msg(std::move(other.a_msg))
         {}
 
         async_msg& operator=(async_msg&& other) SPDLOG_NOEXCEPT
         {
+            msg_type = other.msg_type;
+            flush_id = other.flush_id;
+            payload = other.payload;
             logger_name = std::move(other.logger_name);
             level = other.level;
             time = std::move(other.time);
@@ -97,6 +166,15 @@ async_msg(async_msg&& other) SPDLOG_NOEXCEPT:
             thread_id(m.thread_id),
             txt(m.raw.data(), m.raw.size()),
             a_msg(m.a_msg)
+        {
+            payload = logger_name.size() + txt.size() + a_msg.file_name.owned_size() + a_msg.func_name.owned_size();
+        }
+
+        // construct a flush or terminate message
+        async_msg(async_msg_type type, size_t id = 0) :
+            msg_type(type),
+            flush_id(id),
+            level(level::off)
         {}
 
 
@@ -113,20 +191,118 @@ async_msg(async_msg&& other) SPDLOG_NOEXCEPT:
         }
     };
 
+    // reorder slot of a queue position, free while sequence == position, ready for the writer at position + 1
+    struct formatted_msg
+    {
+        std::atomic<size_t> sequence;
+        async_msg_type msg_type;
+        size_t flush_id;
+        log_msg msg;
+        std::string error; // what() of a formatter exception, rethrown by the writer
+    };
+
 public:
 
     using item_type = async_msg;
-    using q_type = details::mpmc_bounded_queue<item_type>;
+
+    // the bounded queue, or the segmented one
+    class q_type
+    {
+    public:
+        q_type(size_t queue_size, size_t max_segments, bool huge_pages)
+        {
+            if (max_segments)
+                _segmented.reset(new mpmc_segmented_queue<item_type>(queue_size, max_segments));
+            else
+                _bounded.reset(new mpmc_bounded_queue<item_type>(queue_size, huge_pages));
+        }
+
+        bool enqueue(item_type&& item)
+        {
+            return _bounded ? _bounded->enqueue(std::move(item)) : _segmented->enqueue(std::move(item));
+        }
+
+        bool dequeue(item_type& item)
+        {
+            return _bounded ? _bounded->dequeue(item) : _segmented->dequeue(item);
+        }
+
+        bool dequeue(item_type& item, size_t& pos)
+        {
+            return _bounded ? _bounded->dequeue(item, pos) : _segmented->dequeue(item, pos);
+        }
+
+        size_t capacity() const
+        {
+            return _bounded ? _bounded->capacity() : _segmented->capacity();
+        }
+
+        size_t segments() const
+        {
+            return _bounded ? 1 : _segmented->segments();
+        }
+
+        size_t enqueued() const
+        {
+            return _bounded ? _bounded->enqueued() : _segmented->enqueued();
+        }
+
+        size_t dequeued() const
+        {
+            return _bounded ? _bounded->dequeued() : _segmented->dequeued();
+        }
+
+        size_t size_approx() const
+        {
+            return _bounded ? _bounded->size_approx() : _segmented->size_approx();
+        }
+
+        bool lock_memory() const
+        {
+            return _bounded && _bounded->lock_memory();
+        }
+
+        void reset_in_child()
+        {
+            if (_bounded)
+                _bounded->reset_in_child();
+            else
+                _segmented->reset_in_child();
+        }
+
+    private:
+        std::unique_ptr<mpmc_bounded_queue<item_type>> _bounded;
+        std::unique_ptr<mpmc_segmented_queue<item_type>> _segmented;
+    };
+
+    // numa shards: a node's queue, formatted into its own ring by a thread pinned on the node
+    struct shard
+    {
+        std::vector<int> cpus;
+        q_type* q = nullptr;                    // the first shard uses _q
+        std::unique_ptr<q_type> own_q;
+        std::unique_ptr<formatted_msg[]> ring;  // _formatted_size slots, filled in order by the shard thread
+        std::atomic<size_t> taken{0};           // messages dequeued by the shard thread
+        std::atomic<bool> ready{false};         // set up (or failed) by the shard thread
+        bool failed = false;
+        bool locked = false;                    // options.lock_memory succeeded
+        size_t read_pos = 0;                    // the back thread's position in the ring
+        size_t flush_id = 0;                    // last flush marker the back thread took from it
+        bool done = false;                      // the back thread took its terminate marker
+        std::thread thread;
+    };
 
     using clock = std::chrono::steady_clock;
 
 
-    async_log_helper(formatter_ptr formatter,
+    async_log_helper(const std::string& logger_name,
+                     formatter_ptr formatter,
                      const std::vector<sink_ptr>& sinks,
                      size_t queue_size,
                      const async_overflow_policy overflow_policy = async_overflow_policy::block_retry,
                      const std::function<void()>& worker_warmup_cb = nullptr,
-                     const std::chrono::milliseconds& flush_interval_ms = std::chrono::milliseconds::zero());
+                     const std::chrono::milliseconds& flush_interval_ms = std::chrono::milliseconds::zero(),
+                     const async_options& options = async_options());
 
     void log(const details::log_msg& msg);
 
@@ -135,13 +311,73 @@ public:
 
     void set_formatter(formatter_ptr);
 
+    // enqueue a flush marker behind all messages logged so far and wait up to wait_timeout
+    // (zero to return immediately, max to wait without limit) for the back thread to flush the sinks after them.
+    // return true if the sinks were flushed in time. Called from one of the sinks, it does not wait.
+    bool flush(const std::chrono::milliseconds& wait_timeout);
+    // flush(options.flush_timeout)
+    bool flush();
+
+    // number of messages discarded by the overflow policy since creation
+    size_t dropped(level::level_enum lvl) const;
+    size_t dropped() const;
+
+    // queue counters since creation
+    async_stats stats() const;
+
+    // poll mode: write up to max_messages queued messages to the sinks in the calling thread, for at most
+    // about max_time, then handle the periodic flush, drop report and shedding. return the messages written.
+    // sink exceptions are thrown to the caller.
+    size_t drain(size_t max_messages, const log_clock::duration& max_time);
+    bool poll_mode() const;
+    bool pending() const;
+
+    // the event fd of the poll mode helpers (-1 if not supported), readable once a message was enqueued
+    // since the last poll_reset(), which must be called before draining them
+    static int poll_fd();
+    static void poll_reset();
+    static void poll_notify();
+
+    // write the queued messages straight to the sinks' crash_write() from a fatal signal handler.
+    // nothing is locked, allocated or freed: dequeued messages are leaked on purpose.
+    void crash_drain();
+
+    // the helpers alive, scanned by crash_drain_all()
+    static const size_t max_registered = 256;
+    static std::atomic<async_log_helper*>* registered();
+
+    // once set, loggers drop new messages and the back threads stop, so the crash drain owns the queues
+    static std::atomic<bool>& crashing();
+
+    // drain every registered helper once, return false if a drain already started
+    static bool crash_drain_all();
+
+    // park the back threads at a safe point and take the helper's locks, until after_fork() resumes them
+    // in the parent, or in the child drops the queued messages and starts new back threads
+    void prepare_fork();
+    void after_fork(bool child);
+
+    // held by register/unregister, so the fork handler can hold the registered() table across fork()
+    static std::mutex& registered_mutex();
+
+    // a new poll fd in a child, the inherited one would also wake the parent
+    static void renew_poll_fd();
+
+    const std::vector<sink_ptr>& sinks() const;
+
+    // bytes of message data queued in all helpers, and the limit on them (0 for none)
+    static std::atomic<size_t>& memory_in_use();
+    static std::atomic<size_t>& memory_budget();
+
 
 private:
+    const std::string _logger_name;
     formatter_ptr _formatter;
     std::vector<std::shared_ptr<sinks::sink>> _sinks;
 
-    // queue of messages to log
+    // queue of messages to log, and the priority lane (null without one)
     q_type _q;
+    std::unique_ptr<q_type> _high_q;
 
     // last exception thrown from the worker thread
     std::shared_ptr<spdlog_ex> _last_workerthread_ex;
@@ -149,27 +385,198 @@ private:
     // overflow policy
     const async_overflow_policy _overflow_policy;
 
+    // overflow policy parameters and drop report interval
+    const async_options _options;
+
+    // messages discarded per level, and how many of them were already reported by the worker thread
+    std::atomic<size_t> _dropped[level::off + 1];
+    size_t _reported_drops[level::off + 1];
+
+    // enqueues which waited for room, by wait time, and the deepest the queue was seen (by consumers)
+    std::atomic<size_t> _blocked[async_stats::wait_buckets];
+    std::atomic<size_t> _high_water;
+
+    // adaptive shedding: levels below _shed_below are sampled, counted per level as seen and shed.
+    // the stage, the reported counts and the sink write time of the current window belong to the worker.
+    std::atomic<int> _shed_below;
+    std::atomic<size_t> _shed_seen[level::off + 1];
+    std::atomic<size_t> _shed[level::off + 1];
+    size_t _reported_shed[level::off + 1];
+    std::atomic<int> _shed_stage;
+    log_clock::duration _write_time;
+    size_t _writes = 0;
+    log_clock::time_point _last_shed_check;
+
     // worker thread warmup callback - one can set thread priority, affinity, etc
     const std::function<void()> _worker_warmup_cb;
 
     // auto periodic sink flush parameter
     const std::chrono::milliseconds _flush_interval_ms;
 
-    // worker thread
+    // flush markers enqueued and processed so far, waiters are woken by _flush_cond
+    std::atomic<size_t> _flush_requests;
+    size_t _flushed_id = 0;
+    bool _worker_done = false;
+    std::mutex _flush_mutex;
+    std::condition_variable _flush_cond;
+
+    // parallel formatting, empty without formatter threads (queue_size slots)
+    std::unique_ptr<formatted_msg[]> _formatted;
+    const size_t _formatted_size;
+    std::atomic<size_t> _write_pos;
+    std::atomic<bool> _formatters_stop;
+    std::vector<std::thread> _formatter_threads;
+
+    // numa shards, empty without them, the shard of each cpu, and flush() putting its markers in all of them
+    std::vector<std::unique_ptr<shard>> _shards;
+    std::vector<size_t> _cpu_shard;
+    std::atomic<bool> _shards_ready;
+    std::atomic<bool> _shards_stop;
+    std::mutex _flush_enqueue_mutex;
+
+    // worker thread, not started in poll mode
     std::thread _worker_thread;
 
+    // options.lock_memory succeeded
+    bool _memory_locked = false;
+
+    // fork: back threads running, asked to park by prepare_fork(), and parked
+    std::atomic<size_t> _back_threads;
+    std::atomic<bool> _fork_park;
+    std::atomic<size_t> _fork_parked;
+
+    // poll mode: one drain at a time, with the worker loop state
+    std::mutex _drain_mutex;
+    log_clock::time_point _poll_last_flush;
+    log_clock::time_point _poll_last_drop_report;
+
     // throw last worker thread exception or if worker thread is not active
     void throw_if_bad_worker();
 
+    // add/remove this in the registered() table (a full table just leaves the helper out of crash drains)
+    void register_helper();
+    void unregister_helper();
+
+    // set once the poll fd was signaled, until the next poll_reset()
+    static std::atomic<bool>& poll_signaled();
+    static std::atomic<int>& poll_event_fd();
+
+    // counts a back thread out of _back_threads when its loop returns
+    struct back_thread_exit
+    {
+        std::atomic<size_t>& running;
+        ~back_thread_exit()
+        {
+            running.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    };
+
+    // wait there while prepare_fork() asks to
+    void park_for_fork();
+
+    // fixed size buffer to format crash lines without allocating
+    struct crash_buffer
+    {
+        char data[512];
+        size_t size = 0;
+
+        void append(const char* str, size_t len);
+        void append(const char* str);
+        void append_uint(unsigned long long value, size_t width = 0);
+    };
+
+    // charge the message to the memory budget and enqueue it, return false (nothing charged) if either is full.
+    // with enforce_budget false, the message is charged even over the budget.
+    bool try_enqueue(q_type& q, async_msg& msg, bool enforce_budget = true);
+
+    // retry to enqueue until succeeded or the timeout passed, return false on timeout
+    bool enqueue_retry(q_type& q, async_msg&& msg, const log_clock::duration& timeout, bool enforce_budget = true);
+
+    // give back the memory budget of a message leaving the queue
+    static void release_memory(const async_msg& msg);
+
+    // dequeue from the priority lane first
+    bool dequeue_next(async_msg& msg);
+
+    // raise the high-water mark to the current queue depth
+    void update_high_water(size_t current);
+    size_t depth() const;
+
+    // format and write a log message to all sinks
+    void write_log_msg(async_msg& msg, log_msg& formatted);
+
+    // fault in the stack and run the formatter on a throwaway message in the calling thread
+    void warm_up_formatting();
+
+    // options.lock_memory: lock the queues and reorder slots in RAM, return false if any failed
+    bool lock_memory();
+
+    // drain() with _drain_mutex held
+    size_t drain_locked(size_t max_messages, const log_clock::duration& max_time);
+
+    // the helper whose sinks this thread writes to (its worker, or its drain_locked() in poll mode): those
+    // sinks logging or flushing into it again must not wait for the writes they are called from, nor lock
+    // _drain_mutex (held by this very thread)
+    static async_log_helper*& writing_helper()
+    {
+        static thread_local async_log_helper* helper = nullptr;
+        return helper;
+    }
+    bool writing_here() const
+    {
+        return writing_helper() == this;
+    }
+
+    // write a formatted message to all sinks, timing it for the adaptive policy
+    void sink_it(log_msg& msg);
+
+    // format and write a warning from the helper itself
+    void write_report(const log_clock::time_point& time, const std::string& text);
+
+    // once per shed_interval, raise or lower the adaptive shedding stage
+    void handle_shedding(const log_clock::time_point& now);
+
+    // discard the oldest queued message until the new one fits in
+    void enqueue_overwrite(q_type& q, async_msg&& msg);
+
+    // flush all sinks and wake up the flush waiters
+    void handle_flush_msg(size_t flush_id);
+
+    // wake up the flush waiters forever once the worker thread exits
+    void set_worker_done();
+
     // worker thread main loop
     void worker_loop();
 
+    // formatter thread main loop
+    void formatter_loop();
+
+    // wait for the reorder slot of pos to be free, then fill it with msg (formatted if a log message)
+    void fill_slot(size_t pos, async_msg& msg);
+
+    // copy a message to a formatted slot and format it, catching the formatter exceptions into slot.error
+    void format_slot(formatted_msg& slot, async_msg& msg);
+
+    // numa shards: the queue of the producer's node, the shard threads and the back thread merging them
+    q_type& producer_queue();
+    void shard_loop(shard& sh);
+    bool write_next_merged(log_clock::time_point& last_pop, log_clock::time_point& last_flush, log_clock::time_point& last_drop_report);
+
+    // write a priority lane message if there is one
+    bool write_priority(log_clock::time_point& last_pop);
+
+    // write the next reorder slot if ready, same contract as process_next_msg
+    bool write_next_slot(log_clock::time_point& last_pop, log_clock::time_point& last_flush, log_clock::time_point& last_drop_report);
+
     // pop next message from the queue and process it
     // return true if a message was available (queue was not empty), will set the last_pop to the pop time
-    bool process_next_msg(log_clock::time_point& last_pop, log_clock::time_point& last_flush);
+    bool process_next_msg(log_clock::time_point& last_pop, log_clock::time_point& last_flush, log_clock::time_point& last_drop_report);
 
     void handle_flush_interval(log_clock::time_point& now, log_clock::time_point& last_flush);
 
+    // log a "N messages dropped" line if messages were discarded since the last report
+    void handle_drop_report(const log_clock::time_point& now, log_clock::time_point& last_drop_report);
+
     // sleep,yield or return immediatly using the time passed since last message as a hint
     static void sleep_or_yield(const spdlog::log_clock::time_point& now, const log_clock::time_point& last_op_time);
 
@@ -182,58 +589,428 @@ private:
 ///////////////////////////////////////////////////////////////////////////////
 // async_sink class implementation
 ///////////////////////////////////////////////////////////////////////////////
-inline spdlog::details::async_log_helper::async_log_helper(formatter_ptr formatter, const std::vector<sink_ptr>& sinks, size_t queue_size, const async_overflow_policy overflow_policy, const std::function<void()>& worker_warmup_cb, const std::chrono::milliseconds& flush_interval_ms):
+inline spdlog::details::async_log_helper::async_log_helper(const std::string& logger_name, formatter_ptr formatter, const std::vector<sink_ptr>& sinks, size_t queue_size, const async_overflow_policy overflow_policy, const std::function<void()>& worker_warmup_cb, const std::chrono::milliseconds& flush_interval_ms, const async_options& options):
+    _logger_name(logger_name),
     _formatter(formatter),
     _sinks(sinks),
-    _q(queue_size),
+    _q(queue_size, options.max_queue_segments, options.huge_pages),
+    _high_q(options.priority_level < level::off ? new q_type(queue_size, 0, options.huge_pages) : nullptr),
     _overflow_policy(overflow_policy),
+    _options(options),
     _worker_warmup_cb(worker_warmup_cb),
     _flush_interval_ms(flush_interval_ms),
-    _worker_thread(&async_log_helper::worker_loop, this)
-{}
+    _flush_requests(0),
+    _high_water(0),
+    _shed_below(0),
+    _shed_stage(0),
+    _write_time(log_clock::duration::zero()),
+    _formatted_size(queue_size),
+    _write_pos(0),
+    _formatters_stop(false),
+    _shards_ready(false),
+    _shards_stop(false),
+    _back_threads(0),
+    _fork_park(false),
+    _fork_parked(0)
+{
+    for (int i = 0; i <= level::off; ++i)
+    {
+        _dropped[i].store(0, std::memory_order_relaxed);
+        _reported_drops[i] = 0;
+        _shed_seen[i].store(0, std::memory_order_relaxed);
+        _shed[i].store(0, std::memory_order_relaxed);
+        _reported_shed[i] = 0;
+    }
+    for (size_t i = 0; i < async_stats::wait_buckets; ++i)
+        _blocked[i].store(0, std::memory_order_relaxed);
+    if (!_options.shed_sample_rate)
+        throw spdlog_ex("async logger shed sample rate must be at least 1");
+    if (_options.poll_mode && _options.formatter_threads)
+        throw spdlog_ex("async logger in poll mode can't use formatter threads");
+    if ((_options.lock_memory || _options.huge_pages) && _options.max_queue_segments)
+        throw spdlog_ex("async logger memory locking and huge pages need a bounded queue");
+    if (_options.numa_shards)
+    {
+        if (_options.formatter_threads || _options.poll_mode)
+            throw spdlog_ex("async logger numa shards can't be used with formatter threads or poll mode");
+        auto nodes = _options.shard_cpus.empty() ? details::os::numa_nodes() : _options.shard_cpus;
+        for (size_t i = 0; nodes.size() > 1 && i < nodes.size(); ++i)
+        {
+            _shards.emplace_back(new shard());
+            _shards.back()->cpus = nodes[i];
+            for (auto cpu : nodes[i])
+            {
+                if (cpu < 0)
+                    continue;
+                if (_cpu_shard.size() <= static_cast<size_t>(cpu))
+                    _cpu_shard.resize(cpu + 1, 0);
+                _cpu_shard[cpu] = i;
+            }
+        }
+        if (!_shards.empty())
+        {
+            _shards[0]->q = &_q;
+            for (auto &sh : _shards)
+            {
+                _back_threads.fetch_add(1);
+                sh->thread = std::thread(&async_log_helper::shard_loop, this, std::ref(*sh));
+            }
+            // producers may log as soon as we return
+            bool failed = false;
+            for (auto &sh : _shards)
+            {
+                while (!sh->ready.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+                failed = failed || sh->failed;
+            }
+            if (failed)
+            {
+                _shards_stop = true;
+                for (auto &sh : _shards)
+                    sh->thread.join();
+                throw spdlog_ex("async logger could not set up its numa shards");
+            }
+            _shards_ready = true;
+        }
+    }
+    if (_options.formatter_threads)
+    {
+        _formatted.reset(new formatted_msg[_formatted_size]);
+        for (size_t i = 0; i < _formatted_size; ++i)
+            _formatted[i].sequence.store(i, std::memory_order_relaxed);
+        for (size_t i = 0; i < _options.formatter_threads; ++i)
+        {
+            _back_threads.fetch_add(1);
+            _formatter_threads.push_back(std::thread(&async_log_helper::formatter_loop, this));
+        }
+    }
+    if (_options.lock_memory)
+        _memory_locked = lock_memory();
+    if (_options.poll_mode)
+    {
+        if (_options.warm_up)
+            warm_up_formatting();
+        _poll_last_flush = details::os::now();
+        _poll_last_drop_report = _poll_last_flush;
+        _last_shed_check = _poll_last_flush;
+        poll_fd();
+    }
+    else
+    {
+        // start the worker only after all the members it uses are ready
+        _back_threads.fetch_add(1);
+        _worker_thread = std::thread(&async_log_helper::worker_loop, this);
+    }
+    register_helper();
+}
 
 // Send to the worker thread termination message(level=off)
 // and wait for it to finish gracefully
 inline spdlog::details::async_log_helper::~async_log_helper()
 {
 
+    unregister_helper();
+    if (_options.poll_mode)
+    {
+        try
+        {
+            drain(std::numeric_limits<size_t>::max(), log_clock::duration::max());
+            std::lock_guard<std::mutex> lock(_drain_mutex);
+            handle_drop_report(log_clock::time_point::max(), _poll_last_drop_report);
+        }
+        catch (...)
+        {}
+        async_msg leftover;
+        while (dequeue_next(leftover));
+        return;
+    }
     try
     {
-        log(log_msg(level::off));
+        // the termination message must never be discarded by the overflow policy
+        if (_shards.empty())
+            enqueue_retry(_q, async_msg(async_msg_type::terminate), log_clock::duration::max());
+        for (auto &sh : _shards)
+            enqueue_retry(*sh->q, async_msg(async_msg_type::terminate), log_clock::duration::max());
         _worker_thread.join();
+        _formatters_stop = true;
+        for (auto &t : _formatter_threads)
+            t.join();
+        _shards_stop = true;
+        for (auto &sh : _shards)
+            sh->thread.join();
+        // left behind if the worker died, they still hold memory budget
+        async_msg leftover;
+        while (dequeue_next(leftover));
     }
     catch (...) //Dont crash if thread not joinable
     {}
 }
 
 
-//Try to push and block until succeeded
+//Try to push, and if the queue is full act according to the overflow policy
 inline void spdlog::details::async_log_helper::log(const details::log_msg& msg)
 {
+    if (crashing().load(std::memory_order_relaxed))
+        return;
     throw_if_bad_worker();
+    bool priority = _high_q && msg.level >= _options.priority_level;
+    // shed before copying anything
+    if (!priority && msg.level < _shed_below.load(std::memory_order_relaxed) &&
+            _shed_seen[msg.level].fetch_add(1, std::memory_order_relaxed) % _options.shed_sample_rate)
+    {
+        _shed[msg.level].fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
     async_msg new_msg(msg);
-    if (!_q.enqueue(std::move(new_msg)) && _overflow_policy != async_overflow_policy::discard_log_msg)
+    if (priority)
+    {
+        // the lane capacity bounds what it can hold over the memory budget
+        if (!enqueue_retry(*_high_q, std::move(new_msg), log_clock::duration::max(), false))
+            _dropped[msg.level].fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    auto& q = producer_queue();
+    if (try_enqueue(q, new_msg))
+        return;
+
+    switch (_overflow_policy)
+    {
+    case async_overflow_policy::discard_log_msg:
+        break;
+
+    case async_overflow_policy::adaptive:
+        if (new_msg.level < level::warn || !enqueue_retry(q, std::move(new_msg), log_clock::duration::max()))
+            break;
+        return;
+
+    case async_overflow_policy::overwrite_oldest:
+        enqueue_overwrite(q, std::move(new_msg));
+        return;
+
+    case async_overflow_policy::block_timeout:
+        if (enqueue_retry(q, std::move(new_msg), _options.block_timeout))
+            return;
+        break;
+
+    case async_overflow_policy::discard_below_level:
+        if (new_msg.level < _options.discard_level || !enqueue_retry(q, std::move(new_msg), log_clock::duration::max()))
+            break;
+        return;
+
+    default:
+        if (!enqueue_retry(q, std::move(new_msg), log_clock::duration::max()))
+            break;
+        return;
+    }
+    _dropped[msg.level].fetch_add(1, std::memory_order_relaxed);
+}
+
+inline bool spdlog::details::async_log_helper::try_enqueue(q_type& q, async_msg& msg, bool enforce_budget)
+{
+    auto& in_use = memory_in_use();
+    if (msg.payload)
+    {
+        auto before = in_use.fetch_add(msg.payload, std::memory_order_relaxed);
+        auto budget = memory_budget().load(std::memory_order_relaxed);
+        // a message larger than the budget still gets in alone
+        if (enforce_budget && budget && before && before + msg.payload > budget)
+        {
+            in_use.fetch_sub(msg.payload, std::memory_order_relaxed);
+            return false;
+        }
+    }
+    // a failed enqueue leaves msg untouched
+    if (q.enqueue(std::move(msg)))
+    {
+        if (_options.poll_mode)
+            poll_notify();
+        return true;
+    }
+    in_use.fetch_sub(msg.payload, std::memory_order_relaxed);
+    return false;
+}
+
+inline void spdlog::details::async_log_helper::release_memory(const async_msg& msg)
+{
+    if (msg.payload)
+        memory_in_use().fetch_sub(msg.payload, std::memory_order_relaxed);
+}
+
+inline bool spdlog::details::async_log_helper::enqueue_retry(q_type& q, async_msg&& msg, const log_clock::duration& timeout, bool enforce_budget)
+{
+    if (try_enqueue(q, msg, enforce_budget))
+        return true;
+
+    update_high_water(depth());
+    auto start = details::os::now();
+    auto now = start;
+    bool enqueued;
+    while (!(enqueued = try_enqueue(q, msg, enforce_budget)))
+    {
+        if (now - start >= timeout)
+            break;
+        // from one of our sinks, nobody else would make room: the message is dropped
+        if (writing_here())
+            break;
+        // nobody else may drain in poll mode
+        std::unique_lock<std::mutex> drain_lock(_drain_mutex, std::defer_lock);
+        if (!(_options.poll_mode && drain_lock.try_lock() && drain_locked(1, log_clock::duration::max())))
+            sleep_or_yield(now, start);
+        now = details::os::now();
+    }
+
+    auto wait_us = std::chrono::duration_cast<std::chrono::microseconds>(details::os::now() - start).count();
+    size_t bucket = 0;
+    while (wait_us > 0 && bucket < async_stats::wait_buckets - 1)
+    {
+        wait_us >>= 1;
+        ++bucket;
+    }
+    _blocked[bucket].fetch_add(1, std::memory_order_relaxed);
+    return enqueued;
+}
+
+inline void spdlog::details::async_log_helper::enqueue_overwrite(q_type& q, async_msg&& msg)
+{
+    async_msg oldest;
+    size_t pos;
+    do
+    {
+        if (!q.dequeue(oldest, pos))
+        {
+            // the worker emptied the queue in between, or the memory budget is used by other loggers
+            if (!try_enqueue(q, msg))
+                _dropped[msg.level].fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        release_memory(oldest);
+        if (oldest.msg_type == async_msg_type::log)
+        {
+            _dropped[oldest.level].fetch_add(1, std::memory_order_relaxed);
+            oldest.msg_type = async_msg_type::discarded;
+        }
+        // the writer waits for every position, and a flush marker keeps its own
+        if (_formatted)
+            fill_slot(pos, oldest);
+        else if (oldest.msg_type != async_msg_type::discarded) // a flush marker is never discarded, it just moves behind the newer messages
+            enqueue_retry(q, std::move(oldest), log_clock::duration::max());
+    }
+    while (!try_enqueue(q, msg));
+}
+
+inline bool spdlog::details::async_log_helper::flush(const std::chrono::milliseconds& wait_timeout)
+{
+    throw_if_bad_worker();
+    // the crash handler stopped the worker
+    if (crashing().load(std::memory_order_relaxed))
+        return false;
+    size_t flush_id;
+    if (_shards.empty())
+    {
+        flush_id = _flush_requests.fetch_add(1) + 1;
+        enqueue_retry(_q, async_msg(async_msg_type::flush, flush_id), log_clock::duration::max());
+    }
+    else
+    {
+        // the same marker order in every shard, so a shard passing a marker passed the earlier ones
+        std::lock_guard<std::mutex> lock(_flush_enqueue_mutex);
+        flush_id = _flush_requests.fetch_add(1) + 1;
+        for (auto &sh : _shards)
+            enqueue_retry(*sh->q, async_msg(async_msg_type::flush, flush_id), log_clock::duration::max());
+    }
+    // from one of our sinks, which get the marker once they return
+    if (wait_timeout == std::chrono::milliseconds::zero() || writing_here())
+        return false;
+
+    if (_options.poll_mode)
     {
-        auto last_op_time = details::os::now();
-        auto now = last_op_time;
-        do
+        // drain up to our marker, unless another drain takes it, for at most wait_timeout
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        if (wait_timeout != std::chrono::milliseconds::max())
+            deadline = std::chrono::steady_clock::now() + wait_timeout;
+        std::lock_guard<std::mutex> drain_lock(_drain_mutex);
+        for (;;)
         {
-            now = details::os::now();
-            sleep_or_yield(now, last_op_time);
+            {
+                std::lock_guard<std::mutex> lock(_flush_mutex);
+                if (_flushed_id >= flush_id)
+                    return true;
+            }
+            auto max_time = log_clock::duration::max();
+            if (deadline != std::chrono::steady_clock::time_point::max())
+            {
+                auto now = std::chrono::steady_clock::now();
+                if (now >= deadline)
+                    return false;
+                max_time = std::chrono::duration_cast<log_clock::duration>(deadline - now);
+            }
+            drain_locked(std::max<size_t>(depth(), 1), max_time);
         }
-        while (!_q.enqueue(std::move(new_msg)));
     }
 
+    // markers may be processed out of request order, but any processed marker
+    // with a higher id was enqueued after ours, so it covers our messages too
+    std::unique_lock<std::mutex> lock(_flush_mutex);
+    auto flushed = [this, flush_id]()
+    {
+        return _flushed_id >= flush_id || _worker_done;
+    };
+    if (wait_timeout == std::chrono::milliseconds::max())
+        _flush_cond.wait(lock, flushed);
+    else
+        _flush_cond.wait_for(lock, wait_timeout, flushed);
+    return _flushed_id >= flush_id;
+}
+
+inline void spdlog::details::async_log_helper::handle_flush_msg(size_t flush_id)
+{
+    for (auto &s : _sinks)
+        s->flush();
+    std::lock_guard<std::mutex> lock(_flush_mutex);
+    if (flush_id > _flushed_id)
+        _flushed_id = flush_id;
+    _flush_cond.notify_all();
+}
+
+inline void spdlog::details::async_log_helper::set_worker_done()
+{
+    std::lock_guard<std::mutex> lock(_flush_mutex);
+    _worker_done = true;
+    _flush_cond.notify_all();
+}
+
+inline bool spdlog::details::async_log_helper::flush()
+{
+    return flush(_options.flush_timeout);
+}
+
+inline size_t spdlog::details::async_log_helper::dropped(level::level_enum lvl) const
+{
+    return _dropped[lvl].load(std::memory_order_relaxed);
+}
+
+inline size_t spdlog::details::async_log_helper::dropped() const
+{
+    size_t total = 0;
+    for (int i = 0; i <= level::off; ++i)
+        total += _dropped[i].load(std::memory_order_relaxed);
+    return total;
 }
 
 inline void spdlog::details::async_log_helper::worker_loop()
 {
+    back_thread_exit exit{_back_threads};
+    writing_helper() = this;
     try
     {
         if (_worker_warmup_cb) _worker_warmup_cb();
+        if (_options.warm_up)
+            warm_up_formatting();
         auto last_pop = details::os::now();
         auto last_flush = last_pop;
-        while(process_next_msg(last_pop, last_flush));
+        auto last_drop_report = last_pop;
+        _last_shed_check = last_pop;
+        while(process_next_msg(last_pop, last_flush, last_drop_report));
     }
     catch (const std::exception& ex)
     {
@@ -243,65 +1020,682 @@ inline void spdlog::details::async_log_helper::worker_loop()
     {
         _last_workerthread_ex = std::make_shared<spdlog_ex>("async_logger worker thread exception");
     }
+    set_worker_done();
 }
 
 // process next message in the queue
-// return true if this thread should still be active (no msg with level::off was received)
-inline bool spdlog::details::async_log_helper::process_next_msg(log_clock::time_point& last_pop, log_clock::time_point& last_flush)
+// return true if this thread should still be active (no terminate msg was received)
+inline bool spdlog::details::async_log_helper::process_next_msg(log_clock::time_point& last_pop, log_clock::time_point& last_flush, log_clock::time_point& last_drop_report)
 {
+    // leave the queue to the crash drain until the process dies
+    while (crashing().load(std::memory_order_relaxed))
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    park_for_fork();
+    if (_formatted)
+        return write_next_slot(last_pop, last_flush, last_drop_report);
+    if (!_shards.empty())
+        return write_next_merged(last_pop, last_flush, last_drop_report);
 
     async_msg incoming_async_msg;
     log_msg incoming_log_msg;
 
-    if (_q.dequeue(incoming_async_msg))
+    if (dequeue_next(incoming_async_msg))
     {
         last_pop = details::os::now();
 
-        if(incoming_async_msg.level == level::off)
+        if (incoming_async_msg.msg_type == async_msg_type::terminate)
+        {
+            handle_drop_report(log_clock::time_point::max(), last_drop_report);
             return false;
+        }
+        if (incoming_async_msg.msg_type == async_msg_type::flush)
+        {
+            handle_flush_msg(incoming_async_msg.flush_id);
+            last_flush = last_pop;
+            return true;
+        }
 
-        incoming_async_msg.fill_log_msg(incoming_log_msg);
-        _formatter->format(incoming_log_msg);
-        for (auto &s : _sinks)
-            s->log(incoming_log_msg);
+        write_log_msg(incoming_async_msg, incoming_log_msg);
+        // under sustained overflow the queue never gets empty, so report here too
+        handle_drop_report(last_pop, last_drop_report);
+        handle_shedding(last_pop);
     }
     else //empty queue
     {
         auto now = details::os::now();
+        handle_drop_report(now, last_drop_report);
+        handle_shedding(now);
         handle_flush_interval(now, last_flush);
         sleep_or_yield(now, last_pop);
     }
     return true;
 }
 
-inline void spdlog::details::async_log_helper::handle_flush_interval(log_clock::time_point& now, log_clock::time_point& last_flush)
+inline size_t spdlog::details::async_log_helper::drain(size_t max_messages, const log_clock::duration& max_time)
 {
-    if (_flush_interval_ms != std::chrono::milliseconds::zero() && now - last_flush >= _flush_interval_ms)
+    if (writing_here())
+        return 0;
+    std::lock_guard<std::mutex> lock(_drain_mutex);
+    return drain_locked(max_messages, max_time);
+}
+
+inline size_t spdlog::details::async_log_helper::drain_locked(size_t max_messages, const log_clock::duration& max_time)
+{
+    struct writing
     {
-        for (auto &s : _sinks)
-            s->flush();
-        now = last_flush = details::os::now();
+        async_log_helper* previous;
+        explicit writing(async_log_helper* helper) : previous(writing_helper())
+        {
+            writing_helper() = helper;
+        }
+        ~writing()
+        {
+            writing_helper() = previous;
+        }
+    } mark(this);
+    async_msg incoming_async_msg;
+    size_t written = 0;
+    auto start = details::os::now();
+    auto now = start;
+    while (written < max_messages && now - start < max_time && !crashing().load(std::memory_order_relaxed) &&
+            dequeue_next(incoming_async_msg))
+    {
+        now = details::os::now();
+        if (incoming_async_msg.msg_type == async_msg_type::flush)
+        {
+            handle_flush_msg(incoming_async_msg.flush_id);
+            _poll_last_flush = now;
+            continue;
+        }
+        log_msg incoming_log_msg;
+        write_log_msg(incoming_async_msg, incoming_log_msg);
+        ++written;
     }
+    handle_drop_report(now, _poll_last_drop_report);
+    handle_shedding(now);
+    handle_flush_interval(now, _poll_last_flush);
+    return written;
 }
-inline void spdlog::details::async_log_helper::set_formatter(formatter_ptr msg_formatter)
+
+inline bool spdlog::details::async_log_helper::poll_mode() const
 {
-    _formatter = msg_formatter;
+    return _options.poll_mode;
 }
 
+inline bool spdlog::details::async_log_helper::pending() const
+{
+    return depth() != 0;
+}
 
-// sleep,yield or return immediatly using the time passed since last message as a hint
-inline void spdlog::details::async_log_helper::sleep_or_yield(const spdlog::log_clock::time_point& now, const spdlog::log_clock::time_point& last_op_time)
+inline int spdlog::details::async_log_helper::poll_fd()
 {
-    using std::chrono::milliseconds;
-    using namespace std::this_thread;
+    return poll_event_fd().load(std::memory_order_relaxed);
+}
 
-    auto time_since_op = now - last_op_time;
+inline std::atomic<int>& spdlog::details::async_log_helper::poll_event_fd()
+{
+    static std::atomic<int> fd(details::os::event_fd());
+    return fd;
+}
 
-    // spin upto 1 ms
-    if (time_since_op <= milliseconds(1))
-        return;
+inline void spdlog::details::async_log_helper::renew_poll_fd()
+{
+    auto& fd = poll_event_fd();
+    details::os::event_fd_close(fd.load());
+    fd.store(details::os::event_fd());
+    poll_signaled().store(false);
+}
 
-    // yield upto 10ms
+inline void spdlog::details::async_log_helper::poll_reset()
+{
+    // clear the fd first, so an enqueue racing with the reset signals it again
+    details::os::event_fd_clear(poll_fd());
+    poll_signaled().store(false);
+}
+
+inline void spdlog::details::async_log_helper::poll_notify()
+{
+    if (!poll_signaled().exchange(true))
+        details::os::event_fd_signal(poll_fd());
+}
+
+inline bool spdlog::details::async_log_helper::dequeue_next(async_msg& msg)
+{
+    update_high_water(depth());
+    bool found = (_high_q && _high_q->dequeue(msg)) || _q.dequeue(msg);
+    for (size_t i = 1; !found && i < _shards.size(); ++i)
+        found = _shards[i]->q && _shards[i]->q->dequeue(msg);
+    if (!found)
+        return false;
+    release_memory(msg);
+    return true;
+}
+
+inline size_t spdlog::details::async_log_helper::depth() const
+{
+    auto result = _q.size_approx() + (_high_q ? _high_q->size_approx() : 0);
+    for (size_t i = 1; i < _shards.size(); ++i)
+        result += _shards[i]->q ? _shards[i]->q->size_approx() : 0;
+    return result;
+}
+
+inline void spdlog::details::async_log_helper::update_high_water(size_t current)
+{
+    auto high_water = _high_water.load(std::memory_order_relaxed);
+    while (current > high_water && !_high_water.compare_exchange_weak(high_water, current, std::memory_order_relaxed));
+}
+
+inline spdlog::async_stats spdlog::details::async_log_helper::stats() const
+{
+    async_stats result;
+    result.enqueued = _q.enqueued() + (_high_q ? _high_q->enqueued() : 0);
+    result.dequeued = _q.dequeued() + (_high_q ? _high_q->dequeued() : 0);
+    result.dropped = dropped();
+    result.depth = depth();
+    result.high_water = std::max(_high_water.load(std::memory_order_relaxed), result.depth);
+    result.capacity = _q.capacity() + (_high_q ? _high_q->capacity() : 0);
+    result.segments = _q.segments();
+    for (size_t i = 1; i < _shards.size(); ++i)
+    {
+        auto& q = *_shards[i]->q;
+        result.enqueued += q.enqueued();
+        result.dequeued += q.dequeued();
+        result.capacity += q.capacity();
+        result.segments += q.segments();
+    }
+    result.shards = std::max<size_t>(_shards.size(), 1);
+    for (size_t i = 0; i < async_stats::wait_buckets; ++i)
+    {
+        result.wait_us[i] = _blocked[i].load(std::memory_order_relaxed);
+        result.blocked += result.wait_us[i];
+    }
+    for (int i = 0; i <= level::off; ++i)
+        result.shed += _shed[i].load(std::memory_order_relaxed);
+    result.shed_stage = _shed_stage.load(std::memory_order_relaxed);
+    result.memory_locked = _memory_locked;
+    return result;
+}
+
+inline void spdlog::details::async_log_helper::write_log_msg(async_msg& msg, log_msg& formatted)
+{
+    msg.fill_log_msg(formatted);
+    _formatter->format(formatted);
+    sink_it(formatted);
+}
+
+inline void spdlog::details::async_log_helper::warm_up_formatting()
+{
+    volatile char stack[16 * 1024];
+    for (size_t i = 0; i < sizeof(stack); i += 512)
+        stack[i] = 0;
+
+    // set_pattern() may race with the worker start
+    auto formatter = std::atomic_load(&_formatter);
+    for (int i = 0; i < 2; ++i)
+    {
+        log_msg msg(level::info);
+        msg.logger_name = _logger_name;
+        msg.time = details::os::now();
+        msg.thread_id = details::os::thread_id();
+        msg.raw << "warm up " << i << ' ' << 0.5 << ' ' << msg.time.time_since_epoch().count();
+        formatter->format(msg);
+    }
+}
+
+inline bool spdlog::details::async_log_helper::lock_memory()
+{
+    bool locked = _q.lock_memory();
+    if (_high_q)
+        locked = _high_q->lock_memory() && locked;
+    if (_formatted)
+        locked = details::os::lock_pages(_formatted.get(), sizeof(formatted_msg) * _formatted_size) && locked;
+    // the shard threads lock their own queues and rings
+    for (size_t i = 0; i < _shards.size(); ++i)
+        locked = _shards[i]->locked && locked;
+    return locked;
+}
+
+inline void spdlog::details::async_log_helper::sink_it(log_msg& msg)
+{
+    if (_overflow_policy != async_overflow_policy::adaptive)
+    {
+        log_to_sinks(msg, _sinks, _formatter.get());
+        return;
+    }
+    auto start = details::os::now();
+    log_to_sinks(msg, _sinks, _formatter.get());
+    _write_time += details::os::now() - start;
+    ++_writes;
+}
+
+inline bool spdlog::details::async_log_helper::write_next_slot(log_clock::time_point& last_pop, log_clock::time_point& last_flush, log_clock::time_point& last_drop_report)
+{
+    if (write_priority(last_pop))
+        return true;
+
+    auto pos = _write_pos.load(std::memory_order_relaxed);
+    auto& slot = _formatted[pos & (_formatted_size - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+    {
+        // a formatter is on it, give it the cpu rather than spinning
+        if (pos < _q.dequeued())
+        {
+            std::this_thread::yield();
+            return true;
+        }
+        auto now = details::os::now();
+        handle_drop_report(now, last_drop_report);
+        handle_shedding(now);
+        handle_flush_interval(now, last_flush);
+        sleep_or_yield(now, last_pop);
+        return true;
+    }
+
+    last_pop = details::os::now();
+    if (!slot.error.empty())
+        throw spdlog_ex(slot.error);
+    bool active = true;
+    switch (slot.msg_type)
+    {
+    case async_msg_type::terminate:
+        handle_drop_report(log_clock::time_point::max(), last_drop_report);
+        active = false;
+        break;
+    case async_msg_type::flush:
+        handle_flush_msg(slot.flush_id);
+        last_flush = last_pop;
+        break;
+    case async_msg_type::log:
+        sink_it(slot.msg);
+        handle_drop_report(last_pop, last_drop_report);
+        handle_shedding(last_pop);
+        break;
+    default:
+        break;
+    }
+    slot.sequence.store(pos + _formatted_size, std::memory_order_release);
+    _write_pos.store(pos + 1, std::memory_order_relaxed);
+    return active;
+}
+
+inline bool spdlog::details::async_log_helper::write_priority(log_clock::time_point& last_pop)
+{
+    // the priority lane skips the formatter and shard threads, it is formatted and written right away
+    async_msg priority_async_msg;
+    if (!_high_q || !_high_q->dequeue(priority_async_msg))
+        return false;
+    release_memory(priority_async_msg);
+    log_msg priority_log_msg;
+    last_pop = details::os::now();
+    write_log_msg(priority_async_msg, priority_log_msg);
+    return true;
+}
+
+inline bool spdlog::details::async_log_helper::write_next_merged(log_clock::time_point& last_pop, log_clock::time_point& last_flush, log_clock::time_point& last_drop_report)
+{
+    if (write_priority(last_pop))
+        return true;
+
+    // the oldest formatted message, unless a shard is about to deliver one which may be older
+    shard* oldest = nullptr;
+    bool coming = false;
+    bool active = false;
+    for (auto &sh : _shards)
+    {
+        if (sh->done)
+            continue;
+        active = true;
+        auto& slot = sh->ring[sh->read_pos & (_formatted_size - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != sh->read_pos + 1)
+        {
+            coming = coming || sh->taken.load(std::memory_order_acquire) != sh->read_pos || sh->q->size_approx();
+            continue;
+        }
+        if (!slot.error.empty())
+            throw spdlog_ex(slot.error);
+
+        // markers need no ordering, take them right away
+        if (slot.msg_type != async_msg_type::log)
+        {
+            last_pop = details::os::now();
+            if (slot.msg_type == async_msg_type::terminate)
+                sh->done = true;
+            if (slot.msg_type == async_msg_type::flush)
+            {
+                sh->flush_id = std::max(sh->flush_id, slot.flush_id);
+                auto flushed = std::numeric_limits<size_t>::max();
+                for (auto &other : _shards)
+                {
+                    if (!other->done)
+                        flushed = std::min(flushed, other->flush_id);
+                }
+                if (flushed != std::numeric_limits<size_t>::max() && flushed > _flushed_id)
+                {
+                    handle_flush_msg(flushed);
+                    last_flush = last_pop;
+                }
+            }
+            slot.sequence.store(sh->read_pos + _formatted_size, std::memory_order_release);
+            ++sh->read_pos;
+            return true;
+        }
+        if (!oldest || slot.msg.time < oldest->ring[oldest->read_pos & (_formatted_size - 1)].msg.time)
+            oldest = sh.get();
+    }
+
+    if (!active)
+    {
+        handle_drop_report(log_clock::time_point::max(), last_drop_report);
+        return false;
+    }
+    if (oldest && !coming)
+    {
+        last_pop = details::os::now();
+        auto& slot = oldest->ring[oldest->read_pos & (_formatted_size - 1)];
+        sink_it(slot.msg);
+        slot.sequence.store(oldest->read_pos + _formatted_size, std::memory_order_release);
+        ++oldest->read_pos;
+        handle_drop_report(last_pop, last_drop_report);
+        handle_shedding(last_pop);
+        return true;
+    }
+    if (coming)
+    {
+        std::this_thread::yield();
+        return true;
+    }
+    auto now = details::os::now();
+    handle_drop_report(now, last_drop_report);
+    handle_shedding(now);
+    handle_flush_interval(now, last_flush);
+    sleep_or_yield(now, last_pop);
+    return true;
+}
+
+inline spdlog::details::async_log_helper::q_type& spdlog::details::async_log_helper::producer_queue()
+{
+    if (_shards.empty())
+        return _q;
+    auto cpu = details::os::current_cpu();
+    auto index = cpu >= 0 && static_cast<size_t>(cpu) < _cpu_shard.size() ? _cpu_shard[cpu] : 0;
+    return *_shards[index]->q;
+}
+
+inline void spdlog::details::async_log_helper::shard_loop(shard& sh)
+{
+    back_thread_exit exit{_back_threads};
+    // pinned first, so the queue and ring pages get allocated on the node when first touched
+    if (!sh.cpus.empty())
+        details::os::set_thread_affinity(sh.cpus);
+    try
+    {
+        if (!sh.q)
+        {
+            sh.own_q.reset(new q_type(_formatted_size, _options.max_queue_segments, _options.huge_pages));
+            sh.q = sh.own_q.get();
+        }
+        if (!sh.ring)
+        {
+            sh.ring.reset(new formatted_msg[_formatted_size]);
+            for (size_t i = 0; i < _formatted_size; ++i)
+                sh.ring[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        if (_options.lock_memory)
+            sh.locked = sh.q->lock_memory() && details::os::lock_pages(sh.ring.get(), sizeof(formatted_msg) * _formatted_size);
+        if (_options.warm_up)
+            warm_up_formatting();
+    }
+    catch (...)
+    {
+        sh.failed = true;
+    }
+    sh.ready.store(true, std::memory_order_release);
+    if (sh.failed)
+        return;
+    // the other shards' queues are read for the stats
+    while (!_shards_ready.load(std::memory_order_acquire))
+    {
+        if (_shards_stop.load(std::memory_order_relaxed))
+            return;
+        std::this_thread::yield();
+    }
+
+    async_msg incoming_async_msg;
+    size_t pos = 0;
+    auto last_pop = details::os::now();
+    while (!_shards_stop.load(std::memory_order_relaxed))
+    {
+        if (crashing().load(std::memory_order_relaxed))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+        park_for_fork();
+        update_high_water(depth());
+        if (!sh.q->dequeue(incoming_async_msg))
+        {
+            sleep_or_yield(details::os::now(), last_pop);
+            continue;
+        }
+        sh.taken.fetch_add(1, std::memory_order_release);
+        release_memory(incoming_async_msg);
+        last_pop = details::os::now();
+
+        // the back thread frees the slot once done with the message _formatted_size positions earlier
+        auto& slot = sh.ring[pos & (_formatted_size - 1)];
+        while (slot.sequence.load(std::memory_order_acquire) != pos)
+        {
+            if (_shards_stop.load(std::memory_order_relaxed))
+                return;
+            park_for_fork();
+            std::this_thread::yield();
+        }
+        format_slot(slot, incoming_async_msg);
+        slot.sequence.store(pos + 1, std::memory_order_release);
+        ++pos;
+        if (incoming_async_msg.msg_type == async_msg_type::terminate)
+            return;
+    }
+}
+
+inline void spdlog::details::async_log_helper::formatter_loop()
+{
+    back_thread_exit exit{_back_threads};
+    if (_options.warm_up)
+    {
+        try
+        {
+            warm_up_formatting();
+        }
+        catch (...)
+        {}
+    }
+    async_msg incoming_async_msg;
+    size_t pos;
+    auto last_pop = details::os::now();
+    while (!_formatters_stop.load(std::memory_order_relaxed))
+    {
+        if (crashing().load(std::memory_order_relaxed))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+        park_for_fork();
+        update_high_water(depth());
+        if (!_q.dequeue(incoming_async_msg, pos))
+        {
+            sleep_or_yield(details::os::now(), last_pop);
+            continue;
+        }
+        release_memory(incoming_async_msg);
+        last_pop = details::os::now();
+        fill_slot(pos, incoming_async_msg);
+    }
+}
+
+inline void spdlog::details::async_log_helper::fill_slot(size_t pos, async_msg& msg)
+{
+    auto& slot = _formatted[pos & (_formatted_size - 1)];
+    // the writer frees it once done with the message queue_size positions earlier
+    while (slot.sequence.load(std::memory_order_acquire) != pos)
+    {
+        if (_formatters_stop.load(std::memory_order_relaxed))
+            return;
+        park_for_fork();
+        std::this_thread::yield();
+    }
+    format_slot(slot, msg);
+    slot.sequence.store(pos + 1, std::memory_order_release);
+}
+
+inline void spdlog::details::async_log_helper::format_slot(formatted_msg& slot, async_msg& msg)
+{
+    slot.msg_type = msg.msg_type;
+    slot.flush_id = msg.flush_id;
+    slot.error.clear();
+    if (msg.msg_type == async_msg_type::log)
+    {
+        try
+        {
+            msg.fill_log_msg(slot.msg);
+            _formatter->format(slot.msg);
+        }
+        catch (const std::exception& ex)
+        {
+            slot.error = ex.what();
+        }
+        catch (...)
+        {
+            slot.error = "formatter thread exception";
+        }
+    }
+}
+
+inline void spdlog::details::async_log_helper::handle_flush_interval(log_clock::time_point& now, log_clock::time_point& last_flush)
+{
+    if (_flush_interval_ms != std::chrono::milliseconds::zero() && now - last_flush >= _flush_interval_ms)
+    {
+        for (auto &s : _sinks)
+            s->flush();
+        now = last_flush = details::os::now();
+    }
+}
+inline void spdlog::details::async_log_helper::handle_drop_report(const log_clock::time_point& now, log_clock::time_point& last_drop_report)
+{
+    if (_options.drop_report_interval == std::chrono::milliseconds::zero() || now - last_drop_report < _options.drop_report_interval)
+        return;
+    last_drop_report = details::os::now();
+
+    size_t total = 0;
+    fmt::MemoryWriter levels;
+    for (int i = 0; i <= level::off; ++i)
+    {
+        auto count = _dropped[i].load(std::memory_order_relaxed) - _reported_drops[i];
+        if (!count)
+            continue;
+        _reported_drops[i] += count;
+        total += count;
+        levels << (levels.size() ? ", " : "") << level::to_str(static_cast<level::level_enum>(i)) << ": " << count;
+    }
+    if (!total)
+        return;
+
+    fmt::MemoryWriter text;
+    text << total << " messages dropped by the async queue overflow policy (" << levels.str() << ")";
+    write_report(last_drop_report, text.str());
+}
+
+inline void spdlog::details::async_log_helper::write_report(const log_clock::time_point& time, const std::string& text)
+{
+    log_msg report(level::warn);
+    report.logger_name = _logger_name;
+    report.time = time;
+    report.thread_id = details::os::thread_id();
+    report.raw << text;
+    _formatter->format(report);
+    sink_it(report);
+}
+
+inline void spdlog::details::async_log_helper::handle_shedding(const log_clock::time_point& now)
+{
+    if (_overflow_policy != async_overflow_policy::adaptive || now - _last_shed_check < _options.shed_interval)
+        return;
+    _last_shed_check = now;
+
+    auto queued = _q.size_approx();
+    auto capacity = _q.capacity();
+    for (size_t i = 1; i < _shards.size(); ++i)
+    {
+        queued += _shards[i]->q->size_approx();
+        capacity += _shards[i]->q->capacity();
+    }
+    auto occupancy = static_cast<double>(queued) / capacity;
+    auto latency = log_clock::duration::zero();
+    if (_writes)
+        latency = _write_time / static_cast<log_clock::duration::rep>(_writes);
+    _write_time = log_clock::duration::zero();
+    _writes = 0;
+
+    // stage 1 sheds below info, and each next one the following level, up to all below warn
+    const int max_stage = level::warn - level::info + 1;
+    int stage = _shed_stage.load(std::memory_order_relaxed);
+    if (occupancy >= _options.shed_high_water || latency >= _options.shed_write_latency)
+        stage = std::min(stage + 1, max_stage);
+    else if (occupancy <= _options.shed_low_water)
+        stage = std::max(stage - 1, 0);
+    if (stage == _shed_stage.load(std::memory_order_relaxed))
+        return;
+    _shed_stage.store(stage, std::memory_order_relaxed);
+    _shed_below.store(stage ? level::info + stage - 1 : 0, std::memory_order_relaxed);
+
+    fmt::MemoryWriter text;
+    text << "load shedding stage " << stage << " (queue " << static_cast<int>(occupancy * 100) << "% full, sink writes "
+         << std::chrono::duration_cast<std::chrono::microseconds>(latency).count() << "us/msg): keeping ";
+    if (stage)
+    {
+        text << "1 of " << _options.shed_sample_rate;
+        for (int i = 0; i < level::info + stage - 1; ++i)
+            text << (i ? ", " : " ") << level::to_str(static_cast<level::level_enum>(i));
+        text << " messages";
+    }
+    else
+        text << "all messages";
+
+    size_t total = 0;
+    fmt::MemoryWriter levels;
+    for (int i = 0; i <= level::off; ++i)
+    {
+        auto count = _shed[i].load(std::memory_order_relaxed) - _reported_shed[i];
+        if (!count)
+            continue;
+        _reported_shed[i] += count;
+        total += count;
+        levels << (levels.size() ? ", " : "") << level::to_str(static_cast<level::level_enum>(i)) << ": " << count;
+    }
+    if (total)
+        text << ", " << total << " shed since the last change (" << levels.str() << ")";
+    write_report(now, text.str());
+}
+
+inline void spdlog::details::async_log_helper::set_formatter(formatter_ptr msg_formatter)
+{
+    std::atomic_store(&_formatter, msg_formatter);
+}
+
+
+// sleep,yield or return immediatly using the time passed since last message as a hint
+inline void spdlog::details::async_log_helper::sleep_or_yield(const spdlog::log_clock::time_point& now, const spdlog::log_clock::time_point& last_op_time)
+{
+    using std::chrono::milliseconds;
+    using namespace std::this_thread;
+
+    auto time_since_op = now - last_op_time;
+
+    // spin upto 1 ms
+    if (time_since_op <= milliseconds(1))
+        return;
+
+    // yield upto 10ms
     if (time_since_op <= milliseconds(10))
         return yield();
 
@@ -313,6 +1707,309 @@ inline void spdlog::details::async_log_helper::sleep_or_yield(const spdlog::log_
     return sleep_for(milliseconds(100));
 }
 
+inline std::atomic<spdlog::details::async_log_helper*>* spdlog::details::async_log_helper::registered()
+{
+    // zero initialized static storage, usable before and after any constructor runs
+    static std::atomic<async_log_helper*> helpers[max_registered];
+    return helpers;
+}
+
+inline std::atomic<bool>& spdlog::details::async_log_helper::crashing()
+{
+    static std::atomic<bool> flag(false);
+    return flag;
+}
+
+inline std::atomic<size_t>& spdlog::details::async_log_helper::memory_in_use()
+{
+    static std::atomic<size_t> bytes(0);
+    return bytes;
+}
+
+inline std::atomic<bool>& spdlog::details::async_log_helper::poll_signaled()
+{
+    static std::atomic<bool> flag(false);
+    return flag;
+}
+
+inline std::atomic<size_t>& spdlog::details::async_log_helper::memory_budget()
+{
+    static std::atomic<size_t> bytes(0);
+    return bytes;
+}
+
+inline std::mutex& spdlog::details::async_log_helper::registered_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+inline void spdlog::details::async_log_helper::register_helper()
+{
+    std::lock_guard<std::mutex> lock(registered_mutex());
+    auto helpers = registered();
+    for (size_t i = 0; i < max_registered; ++i)
+    {
+        async_log_helper* expected = nullptr;
+        if (helpers[i].compare_exchange_strong(expected, this))
+            return;
+    }
+}
+
+inline void spdlog::details::async_log_helper::unregister_helper()
+{
+    std::lock_guard<std::mutex> lock(registered_mutex());
+    auto helpers = registered();
+    for (size_t i = 0; i < max_registered; ++i)
+    {
+        async_log_helper* expected = this;
+        if (helpers[i].compare_exchange_strong(expected, nullptr))
+            return;
+    }
+}
+
+inline bool spdlog::details::async_log_helper::crash_drain_all()
+{
+    if (crashing().exchange(true))
+        return false;
+    auto helpers = registered();
+    for (size_t i = 0; i < max_registered; ++i)
+    {
+        auto helper = helpers[i].load();
+        if (helper)
+            helper->crash_drain();
+    }
+    return true;
+}
+
+inline const std::vector<spdlog::sink_ptr>& spdlog::details::async_log_helper::sinks() const
+{
+    return _sinks;
+}
+
+inline void spdlog::details::async_log_helper::park_for_fork()
+{
+    if (!_fork_park.load(std::memory_order_acquire))
+        return;
+    _fork_parked.fetch_add(1, std::memory_order_acq_rel);
+    while (_fork_park.load(std::memory_order_acquire))
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    _fork_parked.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+inline void spdlog::details::async_log_helper::prepare_fork()
+{
+    // a flush may wait for room in a shard queue, and a drain writes to the sinks: both need the back threads
+    _flush_enqueue_mutex.lock();
+    _drain_mutex.lock();
+    _fork_park.store(true, std::memory_order_release);
+    while (_fork_parked.load(std::memory_order_acquire) < _back_threads.load(std::memory_order_acquire))
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    _flush_mutex.lock();
+}
+
+inline void spdlog::details::async_log_helper::after_fork(bool child)
+{
+    if (!child)
+    {
+        _flush_mutex.unlock();
+        _fork_park.store(false, std::memory_order_release);
+        _drain_mutex.unlock();
+        _flush_enqueue_mutex.unlock();
+        return;
+    }
+
+    // this thread took the locks in prepare_fork(), and it is alone here. flush waiters of the parent
+    // may have left the condition variable waiting for them
+    new (&_flush_cond) std::condition_variable();
+    _flushed_id = _flush_requests.load();
+    _flush_mutex.unlock();
+    _drain_mutex.unlock();
+    _flush_enqueue_mutex.unlock();
+
+    // the back threads don't exist here: forget them without detaching, and start over with empty queues
+    // and reorder slots, leaked rather than destroyed as the parent's threads may have left them torn
+    new (&_worker_thread) std::thread();
+    for (auto &t : _formatter_threads)
+        new (&t) std::thread();
+    _q.reset_in_child();
+    if (_high_q)
+        _high_q->reset_in_child();
+    if (_formatted)
+    {
+        for (size_t i = 0; i < _formatted_size; ++i)
+        {
+            new (&_formatted[i]) formatted_msg();
+            _formatted[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        _write_pos.store(0, std::memory_order_relaxed);
+    }
+    for (auto &sh : _shards)
+    {
+        new (&sh->thread) std::thread();
+        if (sh->own_q)
+            sh->own_q->reset_in_child();
+        for (size_t i = 0; sh->ring && i < _formatted_size; ++i)
+        {
+            new (&sh->ring[i]) formatted_msg();
+            sh->ring[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        sh->taken.store(0, std::memory_order_relaxed);
+        sh->read_pos = 0;
+        sh->flush_id = 0;
+        sh->done = false;
+    }
+    _fork_park.store(false, std::memory_order_relaxed);
+    _fork_parked.store(0, std::memory_order_relaxed);
+    _back_threads.store(0, std::memory_order_relaxed);
+
+    // memory locks are not inherited
+    if (_options.lock_memory)
+        _memory_locked = lock_memory();
+    for (auto &sh : _shards)
+    {
+        _back_threads.fetch_add(1);
+        sh->thread = std::thread(&async_log_helper::shard_loop, this, std::ref(*sh));
+    }
+    for (auto &t : _formatter_threads)
+    {
+        _back_threads.fetch_add(1);
+        t = std::thread(&async_log_helper::formatter_loop, this);
+    }
+    if (!_options.poll_mode)
+    {
+        _back_threads.fetch_add(1);
+        _worker_thread = std::thread(&async_log_helper::worker_loop, this);
+    }
+}
+
+inline void spdlog::details::async_log_helper::crash_drain()
+{
+    // messages already formatted come first, up to the first one still in a formatter's hands
+    if (_formatted)
+    {
+        for (auto pos = _write_pos.load(); ; ++pos)
+        {
+            auto& slot = _formatted[pos & (_formatted_size - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+                break;
+            if (slot.msg_type != async_msg_type::log || !slot.error.empty())
+                continue;
+            for (auto &s : _sinks)
+                s->crash_write(slot.msg.formatted.data(), slot.msg.formatted.size());
+        }
+    }
+
+    for (auto &sh : _shards)
+    {
+        if (!sh->ring)
+            continue;
+        for (auto pos = sh->read_pos; ; ++pos)
+        {
+            auto& slot = sh->ring[pos & (_formatted_size - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+                break;
+            if (slot.msg_type != async_msg_type::log || !slot.error.empty())
+                continue;
+            for (auto &s : _sinks)
+                s->crash_write(slot.msg.formatted.data(), slot.msg.formatted.size());
+        }
+    }
+
+    // placement new over the same storage without destructing: the moved-out strings are leaked, never freed
+    typename std::aligned_storage<sizeof(async_msg), std::alignment_of<async_msg>::value>::type storage;
+    while (true)
+    {
+        auto msg = new (&storage) async_msg();
+        if (!dequeue_next(*msg))
+            return;
+        if (msg->msg_type != async_msg_type::log)
+            continue;
+
+        // [2016-01-31 23:59:59.999 UTC] [INFO] [logger] text (file.cpp #12 func)
+        using namespace std::chrono;
+        auto since_epoch = duration_cast<milliseconds>(msg->time.time_since_epoch()).count();
+        auto days = since_epoch / 86400000;
+        auto ms_of_day = since_epoch % 86400000;
+        if (ms_of_day < 0)
+        {
+            ms_of_day += 86400000;
+            --days;
+        }
+        int year, month, day;
+        os::civil_from_days(days, year, month, day);
+
+        crash_buffer prefix;
+        prefix.append("[");
+        prefix.append_uint(static_cast<unsigned>(year), 4);
+        prefix.append("-");
+        prefix.append_uint(static_cast<unsigned>(month), 2);
+        prefix.append("-");
+        prefix.append_uint(static_cast<unsigned>(day), 2);
+        prefix.append(" ");
+        prefix.append_uint(static_cast<unsigned long long>(ms_of_day / 3600000), 2);
+        prefix.append(":");
+        prefix.append_uint(static_cast<unsigned long long>(ms_of_day / 60000 % 60), 2);
+        prefix.append(":");
+        prefix.append_uint(static_cast<unsigned long long>(ms_of_day / 1000 % 60), 2);
+        prefix.append(".");
+        prefix.append_uint(static_cast<unsigned long long>(ms_of_day % 1000), 3);
+        prefix.append(" UTC] [");
+        prefix.append(level::to_str(msg->level));
+        prefix.append("] [");
+        prefix.append(msg->logger_name.data(), msg->logger_name.size());
+        prefix.append("] ");
+
+        crash_buffer suffix;
+        if (msg->a_msg.line_num >= 0)
+        {
+            suffix.append(" (");
+            suffix.append(msg->a_msg.file_base_name(), msg->a_msg.file_base_size());
+            suffix.append(" #");
+            suffix.append_uint(static_cast<unsigned>(msg->a_msg.line_num));
+            suffix.append(" ");
+            suffix.append(msg->a_msg.func_name.data(), msg->a_msg.func_name.size());
+            suffix.append(")");
+        }
+        suffix.append(details::os::eol(), details::os::eol_size());
+
+        for (auto &s : _sinks)
+        {
+            s->crash_write(prefix.data, prefix.size);
+            s->crash_write(msg->txt.data(), msg->txt.size());
+            s->crash_write(suffix.data, suffix.size);
+        }
+    }
+}
+
+inline void spdlog::details::async_log_helper::crash_buffer::append(const char* str, size_t len)
+{
+    if (len > sizeof(data) - size)
+        len = sizeof(data) - size;
+    std::memcpy(data + size, str, len);
+    size += len;
+}
+
+inline void spdlog::details::async_log_helper::crash_buffer::append(const char* str)
+{
+    append(str, std::strlen(str));
+}
+
+inline void spdlog::details::async_log_helper::crash_buffer::append_uint(unsigned long long value, size_t width)
+{
+    char digits[20];
+    size_t count = 0;
+    do
+    {
+        digits[sizeof(digits) - ++count] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    while (value && count < sizeof(digits));
+    while (count < width && count < sizeof(digits))
+        digits[sizeof(digits) - ++count] = '0';
+    append(digits + sizeof(digits) - count, count);
+}
+
 // throw if the worker thread threw an exception or not active
 inline void spdlog::details::async_log_helper::throw_if_bad_worker()
 {
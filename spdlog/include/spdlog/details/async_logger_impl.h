@@ -40,9 +40,10 @@ inline spdlog::async_logger::async_logger(const std::string& logger_name,
         size_t queue_size,
         const  async_overflow_policy overflow_policy,
         const std::function<void()>& worker_warmup_cb,
-        const std::chrono::milliseconds& flush_interval_ms) :
+        const std::chrono::milliseconds& flush_interval_ms,
+        const async_options& options) :
     logger(logger_name, begin, end),
-    _async_log_helper(new details::async_log_helper(_formatter, _sinks, queue_size, overflow_policy, worker_warmup_cb, flush_interval_ms))
+    _async_log_helper(new details::async_log_helper(logger_name, _formatter, _sinks, queue_size, overflow_policy, worker_warmup_cb, flush_interval_ms, options))
 {
 }
 
@@ -51,16 +52,18 @@ inline spdlog::async_logger::async_logger(const std::string& logger_name,
         size_t queue_size,
         const  async_overflow_policy overflow_policy,
         const std::function<void()>& worker_warmup_cb,
-        const std::chrono::milliseconds& flush_interval_ms) :
-    async_logger(logger_name, sinks.begin(), sinks.end(), queue_size, overflow_policy, worker_warmup_cb, flush_interval_ms) {}
+        const std::chrono::milliseconds& flush_interval_ms,
+        const async_options& options) :
+    async_logger(logger_name, sinks.begin(), sinks.end(), queue_size, overflow_policy, worker_warmup_cb, flush_interval_ms, options) {}
 
 inline spdlog::async_logger::async_logger(const std::string& logger_name,
         sink_ptr single_sink,
         size_t queue_size,
         const  async_overflow_policy overflow_policy,
         const std::function<void()>& worker_warmup_cb,
-        const std::chrono::milliseconds& flush_interval_ms) :
-    async_logger(logger_name, { single_sink }, queue_size, overflow_policy, worker_warmup_cb, flush_interval_ms) {}
+        const std::chrono::milliseconds& flush_interval_ms,
+        const async_options& options) :
+    async_logger(logger_name, { single_sink }, queue_size, overflow_policy, worker_warmup_cb, flush_interval_ms, options) {}
 
 
 inline void spdlog::async_logger::_set_formatter(spdlog::formatter_ptr msg_formatter)
@@ -80,3 +83,45 @@ inline void spdlog::async_logger::_log_msg(details::log_msg& msg)
 {
     _async_log_helper->log(msg);
 }
+
+inline bool spdlog::async_logger::flush(const std::chrono::milliseconds& wait_timeout)
+{
+    return _async_log_helper->flush(wait_timeout);
+}
+
+inline void spdlog::async_logger::_flush()
+{
+    _async_log_helper->flush();
+}
+
+inline size_t spdlog::async_logger::dropped(level::level_enum lvl) const
+{
+    return _async_log_helper->dropped(lvl);
+}
+
+inline size_t spdlog::async_logger::dropped() const
+{
+    return _async_log_helper->dropped();
+}
+
+inline spdlog::async_stats spdlog::async_logger::stats() const
+{
+    return _async_log_helper->stats();
+}
+
+inline size_t spdlog::async_logger::drain(size_t max_messages, const std::chrono::microseconds& max_time)
+{
+    if (max_time == std::chrono::microseconds::max())
+        return _async_log_helper->drain(max_messages, log_clock::duration::max());
+    return _async_log_helper->drain(max_messages, max_time);
+}
+
+inline bool spdlog::async_logger::poll_mode() const
+{
+    return _async_log_helper->poll_mode();
+}
+
+inline bool spdlog::async_logger::pending() const
+{
+    return _async_log_helper->pending();
+}
@@ -0,0 +1,126 @@
+/*************************************************************************/
+/* spdlog - an extremely fast and easy to use c++11 logging library.     */
+/* Copyright (c) 2014 Gabi Melman.                                       */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+// crash handler :
+// On SIGSEGV, SIGABRT, SIGBUS, SIGFPE or std::terminate, stop the producers and the back threads,
+// write every message still queued in the async loggers to their sinks (crash_write, no locks and no heap),
+// then restore the previous handler and re-raise the signal so the process dies (and dumps core) as before.
+//
+// Only the installing thread gets an alternate signal stack, so a stack overflow elsewhere may not be drained.
+
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+
+#include "async_log_helper.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+namespace spdlog
+{
+namespace details
+{
+
+class crash_handler
+{
+public:
+    // idempotent, only the first call installs the handlers
+    static void install();
+
+private:
+#ifndef _WIN32
+    static const int signal_count = 4;
+    static const int* signals()
+    {
+        static const int sigs[signal_count] = { SIGSEGV, SIGABRT, SIGBUS, SIGFPE };
+        return sigs;
+    }
+
+    static struct sigaction* previous_actions()
+    {
+        static struct sigaction actions[signal_count];
+        return actions;
+    }
+
+    static void on_signal(int sig)
+    {
+        async_log_helper::crash_drain_all();
+
+        // put back whatever was there before us (usually SIG_DFL) and let it terminate the process
+        for (int i = 0; i < signal_count; ++i)
+        {
+            if (signals()[i] == sig)
+                sigaction(sig, &previous_actions()[i], nullptr);
+        }
+        raise(sig);
+    }
+#endif
+
+    static std::terminate_handler& previous_terminate()
+    {
+        static std::terminate_handler handler = nullptr;
+        return handler;
+    }
+
+    static void on_terminate()
+    {
+        async_log_helper::crash_drain_all();
+        auto previous = previous_terminate();
+        if (previous)
+            previous();
+        std::abort();
+    }
+};
+
+}
+}
+
+inline void spdlog::details::crash_handler::install()
+{
+    static std::atomic<bool> installed(false);
+    if (installed.exchange(true))
+        return;
+
+    previous_terminate() = std::set_terminate(&crash_handler::on_terminate);
+
+#ifndef _WIN32
+    static char alt_stack[64 * 1024];
+    stack_t ss;
+    ss.ss_sp = alt_stack;
+    ss.ss_size = sizeof(alt_stack);
+    ss.ss_flags = 0;
+    sigaltstack(&ss, nullptr);
+
+    struct sigaction action;
+    action.sa_handler = &crash_handler::on_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_ONSTACK;
+    for (int i = 0; i < signal_count; ++i)
+        sigaction(signals()[i], &action, &previous_actions()[i]);
+#endif
+}
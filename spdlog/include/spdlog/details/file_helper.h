@@ -33,6 +33,9 @@
 #include <thread>
 #include <chrono>
 #include "os.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 
 
@@ -113,6 +116,20 @@ public:
 
     }
 
+    // write bypassing stdio, from a fatal signal handler.
+    // stdio is not async-signal-safe, so what it still buffers (nothing with force_flush) is left behind.
+    void crash_write(const char* data, size_t size)
+    {
+#ifndef _WIN32
+        if (!_fd)
+            return;
+        os::crash_write(fileno(_fd), data, size);
+#else
+        (void)data;
+        (void)size;
+#endif
+    }
+
     const std::string& filename() const
     {
         return _filename;
@@ -0,0 +1,181 @@
+/*************************************************************************/
+/* spdlog - an extremely fast and easy to use c++11 logging library.     */
+/* Copyright (c) 2014 Gabi Melman.                                       */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+// fork handler :
+// Make fork() safe for prefork servers which log before forking (pthread_atfork).
+// Before fork(), take the registry lock, park the back threads of the async loggers at a safe point, then
+// flush and lock every sink of the registered loggers and async helpers, shared writers first (they stop
+// their thread and write to the sinks they wrap). So the child inherits no lock held by a thread it
+// doesn't have, and no line buffered by the parent. Afterwards the parent resumes everything, and the
+// child drops what the parent's threads had queued, starts its own back threads and poll fd, and
+// reopens the file sinks set to a per-child name (set_child_pid_suffix).
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "async_log_helper.h"
+#include "registry.h"
+#include "../sinks/shared_writer_sink.h"
+
+namespace spdlog
+{
+namespace details
+{
+
+class fork_handler
+{
+public:
+    // idempotent, only the first call installs the handlers (nothing on windows)
+    static void install();
+
+private:
+    static void prepare();
+    static void parent();
+    static void child();
+    static void resume(bool child);
+
+    // taken by prepare(), released in reverse order by resume()
+    static std::vector<async_log_helper*>& helpers()
+    {
+        static std::vector<async_log_helper*> prepared;
+        return prepared;
+    }
+
+    static std::vector<sink_ptr>& sinks()
+    {
+        static std::vector<sink_ptr> prepared;
+        return prepared;
+    }
+};
+
+}
+}
+
+inline void spdlog::details::fork_handler::install()
+{
+    static std::atomic<bool> installed(false);
+    if (installed.exchange(true))
+        return;
+    os::at_fork(&fork_handler::prepare, &fork_handler::parent, &fork_handler::child);
+}
+
+inline void spdlog::details::fork_handler::prepare()
+{
+    // the same lock order as a logger created by the registry: registry, then helper table
+    auto loggers = registry::instance().fork_lock();
+    async_log_helper::registered_mutex().lock();
+
+    auto table = async_log_helper::registered();
+    std::vector<sink_ptr> all;
+    for (size_t i = 0; i < async_log_helper::max_registered; ++i)
+    {
+        auto helper = table[i].load();
+        if (!helper)
+            continue;
+        helper->prepare_fork();
+        helpers().push_back(helper);
+        all.insert(all.end(), helper->sinks().begin(), helper->sinks().end());
+    }
+    for (auto &l : loggers)
+        all.insert(all.end(), l->sinks().begin(), l->sinks().end());
+
+    // each sink once, the shared writers before the sinks they wrap
+    auto add = [](const sink_ptr& s)
+    {
+        for (auto &prepared : sinks())
+        {
+            if (prepared == s)
+                return;
+        }
+        sinks().push_back(s);
+    };
+    for (auto &s : all)
+    {
+        if (std::dynamic_pointer_cast<sinks::shared_writer_sink>(s))
+            add(s);
+    }
+    for (size_t i = 0, writers = sinks().size(); i < writers; ++i)
+        add(std::static_pointer_cast<sinks::shared_writer_sink>(sinks()[i])->wrapped());
+    for (auto &s : all)
+        add(s);
+    // a sink failing to flush is still locked
+    for (auto &s : sinks())
+    {
+        try
+        {
+            s->prepare_fork();
+        }
+        catch (...)
+        {}
+    }
+}
+
+inline void spdlog::details::fork_handler::parent()
+{
+    resume(false);
+}
+
+inline void spdlog::details::fork_handler::child()
+{
+    resume(true);
+}
+
+inline void spdlog::details::fork_handler::resume(bool child)
+{
+    // a sink or helper failing to start over in the child logs nothing, it must not stop the others
+    for (auto s = sinks().rbegin(); s != sinks().rend(); ++s)
+    {
+        try
+        {
+            (*s)->after_fork(child);
+        }
+        catch (...)
+        {}
+    }
+    bool poll_mode = false;
+    for (auto h = helpers().rbegin(); h != helpers().rend(); ++h)
+    {
+        poll_mode = poll_mode || (*h)->poll_mode();
+        try
+        {
+            (*h)->after_fork(child);
+        }
+        catch (...)
+        {}
+    }
+    if (child)
+    {
+        // nothing is queued anymore
+        async_log_helper::memory_in_use().store(0);
+        if (poll_mode)
+            async_log_helper::renew_poll_fd();
+    }
+    sinks().clear();
+    helpers().clear();
+    async_log_helper::registered_mutex().unlock();
+    registry::instance().fork_unlock();
+}
@@ -2097,6 +2097,13 @@ public:
         return &buffer_[0];
     }
 
+    /**
+    Returns the output buffer, to reserve room or append characters as is.
+    */
+    Buffer<Char> &buffer() FMT_NOEXCEPT {
+        return buffer_;
+    }
+
     /**
     Returns a pointer to the output buffer content with terminating null
     character appended.
@@ -0,0 +1,193 @@
+/*************************************************************************/
+/* spdlog - an extremely fast and easy to use c++11 logging library.     */
+/* Copyright (c) 2014 Gabi Melman.                                       */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#define SPDLOG_JSON_SSE2
+#endif
+
+#include "../json_formatter.h"
+#include "./os.h"
+#include "./sanitize.h"
+
+namespace spdlog
+{
+namespace details
+{
+
+// bytes from 0x80 are stopped at too, to check their UTF-8
+inline bool json_needs_escape(unsigned char c)
+{
+    return c < 0x20 || c == '"' || c == '\\' || c >= 0x80;
+}
+
+// offset of the first byte of s[0, n) to escape or check, n if none.
+// 16 bytes at a time with SSE2: a byte needs escaping if it is '"', '\\' or at most 0x1f (max_epu8 keeps it
+// at 0x1f), and checking if its high bit is set.
+inline size_t json_clean_run(const char* s, size_t n)
+{
+    size_t i = 0;
+#ifdef SPDLOG_JSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash)),
+                                        _mm_cmpeq_epi8(_mm_max_epu8(bytes, control), control));
+        int mask = _mm_movemask_epi8(special) | _mm_movemask_epi8(bytes);
+        if (mask)
+        {
+#ifdef _MSC_VER
+            unsigned long first;
+            _BitScanForward(&first, static_cast<unsigned long>(mask));
+            return i + first;
+#else
+            return i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+#endif
+        }
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        if (json_needs_escape(static_cast<unsigned char>(s[i])))
+            return i;
+    }
+    return n;
+}
+
+// s[0, n) as the inside of a JSON string, clean runs copied at once.
+// bytes of invalid UTF-8, which strict parsers reject, are written as \ufffd
+inline void append_json_escaped(fmt::MemoryWriter& w, const char* s, size_t n)
+{
+    static const char hex[] = "0123456789abcdef";
+    while (n)
+    {
+        size_t clean = json_clean_run(s, n);
+        append(w, s, clean);
+        if (clean == n)
+            return;
+        unsigned char c = static_cast<unsigned char>(s[clean]);
+        if (c >= 0x80)
+        {
+            size_t len = utf8_sequence(s + clean, n - clean);
+            if (len)
+                append(w, s + clean, len);
+            else
+            {
+                append(w, "\\ufffd", 6);
+                len = 1;
+            }
+            s += clean + len;
+            n -= clean + len;
+            continue;
+        }
+        switch (c)
+        {
+        case '"': append(w, "\\\"", 2); break;
+        case '\\': append(w, "\\\\", 2); break;
+        case '\n': append(w, "\\n", 2); break;
+        case '\r': append(w, "\\r", 2); break;
+        case '\t': append(w, "\\t", 2); break;
+        case '\b': append(w, "\\b", 2); break;
+        case '\f': append(w, "\\f", 2); break;
+        default:
+        {
+            const char escaped[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+            append(w, escaped, sizeof(escaped));
+            break;
+        }
+        }
+        s += clean + 1;
+        n -= clean + 1;
+    }
+}
+
+inline void append_json_string(fmt::MemoryWriter& w, const char* key, size_t key_size, const std::string& value)
+{
+    append(w, key, key_size);
+    append_json_escaped(w, value.data(), value.size());
+    append(w, '"');
+}
+
+}
+}
+
+inline spdlog::json_formatter::json_formatter(const time_zone& tz) :
+    _time(tz)
+{
+}
+
+inline void spdlog::json_formatter::format(details::log_msg& msg)
+{
+    auto& w = msg.formatted;
+    auto tm_time = _time.get(log_clock::to_time_t(msg.time));
+    // room for the line without escapes
+    w.buffer().reserve(w.size() + 128 + details::os::eol_size() + msg.logger_name.size() + msg.raw.size() +
+                       msg.a_msg.file_name.size() + msg.a_msg.func_name.size());
+
+    details::write_second_run(_time_prefix, msg, [&]
+    {
+        details::append(w, "{\"time\":\"", 9);
+        details::append_digits(w, static_cast<unsigned>(tm_time.tm_year + 1900), 4);
+        details::append(w, '-');
+        details::append_digits(w, static_cast<unsigned>(tm_time.tm_mon + 1), 2);
+        details::append(w, '-');
+        details::append_digits(w, static_cast<unsigned>(tm_time.tm_mday), 2);
+        details::append(w, 'T');
+        details::pad_n_join(w, tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec, ':');
+    });
+    details::append(w, '.');
+    details::write_field(details::pattern_op::millis, msg, tm_time);
+    details::write_field(details::pattern_op::utc_offset, msg, tm_time);
+
+    details::append(w, "\",\"level\":\"", 11);
+    details::append(w, level::to_str(msg.level));
+    details::append_json_string(w, "\",\"logger\":\"", 12, msg.logger_name);
+    details::append(w, ",\"thread\":", 10);
+    details::append_digits(w, msg.thread_id, 1);
+    if (msg.a_msg.line_num > 0)
+    {
+        details::append(w, ",\"file\":\"", 9);
+        details::append_json_escaped(w, msg.a_msg.file_base_name(), msg.a_msg.file_base_size());
+        details::append(w, "\",\"line\":", 9);
+        details::append_digits(w, static_cast<unsigned>(msg.a_msg.line_num), 1);
+        details::append(w, ",\"func\":\"", 9);
+        details::append_json_escaped(w, msg.a_msg.func_name.data(), msg.a_msg.func_name.size());
+        details::append(w, '"');
+    }
+    details::append(w, ",\"msg\":\"", 8);
+    details::append_json_escaped(w, msg.raw.data(), msg.raw.size());
+    details::append(w, "\"}", 2);
+    details::append(w, details::os::eol(), details::os::eol_size());
+}
@@ -74,6 +74,7 @@ public:
 #ifndef SPDLOG_NO_THREAD_ID
             _log_msg.thread_id = os::thread_id();
 #endif
+            _callback_logger->_sanitize_msg(_log_msg);
             _callback_logger->_log_msg(_log_msg);
         }
     }
@@ -32,13 +32,128 @@ namespace spdlog
 {
 namespace details
 {
+// compile time scan of a source path for the part the #f flag prints: the path past SPDLOG_FILE_PREFIX
+// if it starts with it, else the base name. halves the range at each step, so long paths stay
+// well under the constexpr recursion limit
+constexpr bool is_path_sep(char c)
+{
+    return c == '/' || c == '\\' || c == '(';
+}
+
+constexpr size_t past_last_sep(const char* path, size_t lo, size_t hi);
+constexpr size_t past_last_sep_or(size_t found, const char* path, size_t lo, size_t hi)
+{
+    return found ? found : past_last_sep(path, lo, hi);
+}
+// one past the last separator in [lo, hi), 0 if there is none
+constexpr size_t past_last_sep(const char* path, size_t lo, size_t hi)
+{
+    return hi - lo <= 1 ? (hi > lo && is_path_sep(path[lo]) ? hi : 0) :
+           past_last_sep_or(past_last_sep(path, lo + (hi - lo) / 2, hi), path, lo, lo + (hi - lo) / 2);
+}
+
+constexpr bool same_chars(const char* a, const char* b, size_t lo, size_t hi)
+{
+    return hi - lo <= 1 ? (hi == lo || a[lo] == b[lo]) :
+           same_chars(a, b, lo, lo + (hi - lo) / 2) && same_chars(a, b, lo + (hi - lo) / 2, hi);
+}
+
+template <size_t N, size_t P>
+constexpr size_t file_base_offset(const char (&path)[N], const char (&prefix)[P])
+{
+    return P > 1 && P <= N && same_chars(path, prefix, 0, P - 1) ? P - 1 : past_last_sep(path, 0, N - 1);
+}
+
+template <size_t N>
+constexpr size_t file_base_offset(const char (&path)[N])
+{
+#ifdef SPDLOG_FILE_PREFIX
+    return file_base_offset(path, SPDLOG_FILE_PREFIX);
+#else
+    return past_last_sep(path, 0, N - 1);
+#endif
+}
+
+// a file or function name of a call site: a string living as long as the program (__FILE__, __FUNCTION__),
+// only pointed to, or an owned copy of any other one
+class source_str
+{
+public:
+    source_str() = default;
+    source_str(std::string s) : _owned(std::move(s)), _size(_owned.size()) {}
+
+    static source_str of_static(const char* s, size_t n)
+    {
+        source_str str;
+        str._static = s;
+        str._size = n;
+        return str;
+    }
+
+    const char* data() const
+    {
+        return _static ? _static : _owned.data();
+    }
+    size_t size() const
+    {
+        return _size;
+    }
+    // heap bytes held, none for a static string
+    size_t owned_size() const
+    {
+        return _static ? 0 : _size;
+    }
+    std::string str() const
+    {
+        return std::string(data(), _size);
+    }
+    void assign(const char* s, size_t n)
+    {
+        _owned.assign(s, n);
+        _static = nullptr;
+        _size = n;
+    }
+
+private:
+    std::string _owned;
+    const char* _static = nullptr;
+    size_t _size = 0;
+};
+
 struct add_msg
 {
-    std::string file_name;
-    std::string func_name;
+    source_str file_name;
+    source_str func_name;
     int line_num;
+    size_t file_base; // offset in file_name of the part the #f flag prints
     add_msg(std::string file="", std::string func="", int line=-1)
-        :file_name(file), func_name(func), line_num(line){};
+        :file_name(std::move(file)), func_name(std::move(func)), line_num(line)
+    {
+        file_base = past_last_sep(file_name.data(), 0, file_name.size());
+    }
+
+    // for call sites (SSPD_LOG_LINE_INFO): file and func are kept as pointers, so they must be static
+    // strings like __FILE__ and __FUNCTION__, base is file_base_offset(file) computed by the compiler
+    template <size_t F, size_t N>
+    static add_msg call_site(const char (&file)[F], size_t base, const char (&func)[N], int line)
+    {
+        add_msg a_msg;
+        a_msg.file_name = source_str::of_static(file, F - 1);
+        a_msg.func_name = source_str::of_static(func, N - 1);
+        a_msg.line_num = line;
+        a_msg.file_base = base;
+        return a_msg;
+    }
+
+    // the part of file_name #f prints, file_base is ignored if file_name was since replaced by a shorter one
+    const char* file_base_name() const
+    {
+        return file_name.data() + (file_base <= file_name.size() ? file_base : 0);
+    }
+    size_t file_base_size() const
+    {
+        return file_name.size() - (file_base <= file_name.size() ? file_base : 0);
+    }
 };
 struct log_msg
 {
@@ -28,6 +28,8 @@
 //
 
 #include "./line_logger.h"
+#include "./sink_dispatch.h"
+#include "./sanitize.h"
 
 
 // create logger with given name, sinks and the default pattern formatter
@@ -41,6 +43,7 @@ inline spdlog::logger::logger(const std::string& logger_name, const It& begin, c
 
     // no support under vs2013 for member initialization for std::atomic
     _level = level::info;
+    _sanitize = static_cast<int>(sanitize_mode::none);
 }
 
 // ctor with sinks as init list
@@ -280,11 +283,26 @@ inline const std::string& spdlog::logger::name() const
     return _name;
 }
 
+inline const std::vector<spdlog::sink_ptr>& spdlog::logger::sinks() const
+{
+    return _sinks;
+}
+
 inline void spdlog::logger::set_level(spdlog::level::level_enum log_level)
 {
     _level.store(log_level);
 }
 
+inline void spdlog::logger::set_sanitize(spdlog::sanitize_mode mode)
+{
+    _sanitize.store(static_cast<int>(mode));
+}
+
+inline spdlog::sanitize_mode spdlog::logger::sanitize() const
+{
+    return static_cast<spdlog::sanitize_mode>(_sanitize.load(std::memory_order_relaxed));
+}
+
 inline spdlog::level::level_enum spdlog::logger::level() const
 {
     return static_cast<spdlog::level::level_enum>(_level.load(std::memory_order_relaxed));
@@ -301,8 +319,7 @@ inline bool spdlog::logger::should_log(spdlog::level::level_enum msg_level) cons
 inline void spdlog::logger::_log_msg(details::log_msg& msg)
 {
     _formatter->format(msg);
-    for (auto &sink : _sinks)
-        sink->log(msg);
+    details::log_to_sinks(msg, _sinks, _formatter.get());
 }
 
 inline void spdlog::logger::_set_pattern(const std::string& pattern)
@@ -314,7 +331,25 @@ inline void spdlog::logger::_set_formatter(formatter_ptr msg_formatter)
     _formatter = msg_formatter;
 }
 
-inline void spdlog::logger::flush() {
+inline void spdlog::logger::flush()
+{
+    _flush();
+}
+
+inline void spdlog::logger::replay(details::log_msg& msg)
+{
+    _sanitize_msg(msg);
+    _log_msg(msg);
+}
+
+// in the logging thread, before the message is queued or formatted
+inline void spdlog::logger::_sanitize_msg(details::log_msg& msg)
+{
+    details::sanitize(msg.raw, sanitize());
+}
+
+inline void spdlog::logger::_flush()
+{
     for (auto& sink : _sinks)
         sink->flush();
 }
\ No newline at end of file
@@ -62,7 +62,9 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #pragma once
 
 #include <atomic>
+#include <new>
 #include "../common.h"
+#include "./os.h"
 
 namespace spdlog
 {
@@ -75,14 +77,11 @@ class mpmc_bounded_queue
 public:
 
     using item_type = T;
-    mpmc_bounded_queue(size_t buffer_size)
-        : buffer_(new cell_t [buffer_size]),
+    // huge_pages: align the cells on huge pages, see os::page_alloc()
+    mpmc_bounded_queue(size_t buffer_size, bool huge_pages = false)
+        : buffer_(new_buffer(checked_size(buffer_size), huge_pages)),
           buffer_mask_(buffer_size - 1)
     {
-        //queue size must be power of two
-        if(!((buffer_size >= 2) && ((buffer_size & (buffer_size - 1)) == 0)))
-            throw spdlog_ex("async logger queue size must be power of two");
-
         for (size_t i = 0; i != buffer_size; i += 1)
             buffer_[i].sequence_.store(i, std::memory_order_relaxed);
         enqueue_pos_.store(0, std::memory_order_relaxed);
@@ -91,7 +90,9 @@ public:
 
     ~mpmc_bounded_queue()
     {
-        delete [] buffer_;
+        for (size_t i = 0; i != buffer_mask_ + 1; i += 1)
+            buffer_[i].~cell_t();
+        os::page_free(buffer_);
     }
 
 
@@ -124,6 +125,13 @@ public:
     }
 
     bool dequeue(T& data)
+    {
+        size_t pos;
+        return dequeue(data, pos);
+    }
+
+    // also return the position of the item, enqueue order numbers starting from 0
+    bool dequeue(T& data, size_t& pos_out)
     {
         cell_t* cell;
         size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
@@ -145,9 +153,52 @@ public:
         }
         data = std::move(cell->data_);
         cell->sequence_.store(pos + buffer_mask_ + 1, std::memory_order_release);
+        pos_out = pos;
         return true;
     }
 
+    size_t capacity() const
+    {
+        return buffer_mask_ + 1;
+    }
+
+    // keep the cells in RAM (they were all written when constructed, so they are already faulted in)
+    bool lock_memory() const
+    {
+        return os::lock_pages(buffer_, sizeof(cell_t) * capacity());
+    }
+
+    // start over empty in a child after fork(), the only thread left: cells which other threads of the parent
+    // were writing may be torn, so their items are leaked instead of destroyed
+    void reset_in_child()
+    {
+        for (size_t i = 0; i != capacity(); i += 1)
+        {
+            new (&buffer_[i].data_) T();
+            buffer_[i].sequence_.store(i, std::memory_order_relaxed);
+        }
+        enqueue_pos_.store(0, std::memory_order_relaxed);
+        dequeue_pos_.store(0, std::memory_order_relaxed);
+    }
+
+    // number of items enqueued/dequeued so far, and their difference (approximate while in use)
+    size_t enqueued() const
+    {
+        return enqueue_pos_.load(std::memory_order_relaxed);
+    }
+
+    size_t dequeued() const
+    {
+        return dequeue_pos_.load(std::memory_order_relaxed);
+    }
+
+    size_t size_approx() const
+    {
+        // dequeue_pos_ never passes enqueue_pos_, so load it first
+        size_t dequeue_pos = dequeue_pos_.load(std::memory_order_relaxed);
+        return enqueue_pos_.load(std::memory_order_relaxed) - dequeue_pos;
+    }
+
 private:
     struct cell_t
     {
@@ -155,6 +206,24 @@ private:
         T                     data_;
     };
 
+    static size_t checked_size(size_t buffer_size)
+    {
+        //queue size must be power of two
+        if(!((buffer_size >= 2) && ((buffer_size & (buffer_size - 1)) == 0)))
+            throw spdlog_ex("async logger queue size must be power of two");
+        return buffer_size;
+    }
+
+    static cell_t* new_buffer(size_t buffer_size, bool huge_pages)
+    {
+        auto buffer = static_cast<cell_t*>(os::page_alloc(sizeof(cell_t) * buffer_size, huge_pages));
+        if (!buffer)
+            throw std::bad_alloc();
+        for (size_t i = 0; i != buffer_size; i += 1)
+            new (&buffer[i]) cell_t();
+        return buffer;
+    }
+
     static size_t const     cacheline_size = 64;
     typedef char            cacheline_pad_t [cacheline_size];
 
@@ -0,0 +1,366 @@
+/*************************************************************************/
+/* spdlog - an extremely fast and easy to use c++11 logging library.     */
+/* Copyright (c) 2014 Gabi Melman.                                       */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+// Lock free multi producer multi consumer queue growing by segments, after mpmc_bounded_queue.
+//
+// Positions are mapped on a ring of max_segments * segment_size cells (the hard ceiling), but the cells
+// only exist in segments, installed in the ring's directory when producers reach them, and retired
+// to a free list by the consumer which drains the last cell. So a queue mostly holds the few segments
+// in use, and grows up to the ceiling during bursts.
+//
+// Each directory slot serves the laps of positions base, base + capacity, ... in turn. A producer claims
+// the right to install the next lap's segment through the slot's next_base, so one running late can never
+// install a segment for a lap already gone by. Segments are only deleted with the queue, so a stale
+// segment pointer is always safe to read: its base tells which lap it currently serves.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <cstdint>
+#include "../common.h"
+
+namespace spdlog
+{
+namespace details
+{
+
+template<typename T>
+class mpmc_segmented_queue
+{
+public:
+
+    using item_type = T;
+    mpmc_segmented_queue(size_t segment_size, size_t max_segments)
+        : segment_size_(segment_size),
+          segment_mask_(segment_size - 1),
+          max_segments_(max_segments),
+          capacity_(segment_size * max_segments),
+          directory_(new std::atomic<segment_t*>[max_segments]),
+          next_base_(new std::atomic<size_t>[max_segments]),
+          free_(new std::atomic<segment_t*>[max_segments])
+    {
+        //segment size must be power of two
+        if(!((segment_size >= 2) && ((segment_size & (segment_size - 1)) == 0)))
+            throw spdlog_ex("async logger queue size must be power of two");
+        if (!max_segments)
+            throw spdlog_ex("async logger queue needs at least one segment");
+
+        for (size_t i = 0; i != max_segments; i += 1)
+        {
+            directory_[i].store(nullptr, std::memory_order_relaxed);
+            next_base_[i].store(i * segment_size, std::memory_order_relaxed);
+            free_[i].store(nullptr, std::memory_order_relaxed);
+        }
+        allocated_.store(1, std::memory_order_relaxed);
+        enqueue_pos_.store(0, std::memory_order_relaxed);
+        dequeue_pos_.store(0, std::memory_order_relaxed);
+
+        // the first segment up front, an idle queue costs as much as a bounded one of segment_size
+        auto first = new segment_t(segment_size);
+        first->reset(0, segment_size);
+        directory_[0].store(first, std::memory_order_relaxed);
+        next_base_[0].store(capacity_, std::memory_order_relaxed);
+    }
+
+    ~mpmc_segmented_queue()
+    {
+        for (size_t i = 0; i != max_segments_; i += 1)
+        {
+            delete directory_[i].load(std::memory_order_relaxed);
+            delete free_[i].load(std::memory_order_relaxed);
+        }
+    }
+
+
+    bool enqueue(T&& data)
+    {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            size_t base = pos & ~segment_mask_;
+            size_t index = (pos / segment_size_) % max_segments_;
+            segment_t* segment = directory_[index].load(std::memory_order_acquire);
+            if (segment && segment->base.load(std::memory_order_acquire) == base)
+            {
+                cell_t& cell = segment->cells[pos & segment_mask_];
+                size_t seq = cell.sequence_.load(std::memory_order_acquire);
+                intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+                if (dif == 0)
+                {
+                    if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        cell.data_ = std::move(data);
+                        cell.sequence_.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else
+                {
+                    pos = enqueue_pos_.load(std::memory_order_relaxed);
+                }
+                continue;
+            }
+
+            size_t current = enqueue_pos_.load(std::memory_order_relaxed);
+            if (current != pos)
+            {
+                pos = current;
+                continue;
+            }
+            if (segment)
+            {
+                // the slot still serves the previous lap: full, unless its last consumer is retiring it right now
+                if (segment->drained.load(std::memory_order_acquire) != segment_size_)
+                    return false;
+                continue;
+            }
+            if (!install(index, base))
+                return false;
+        }
+    }
+
+    bool dequeue(T& data)
+    {
+        size_t pos;
+        return dequeue(data, pos);
+    }
+
+    // also return the position of the item, enqueue order numbers starting from 0
+    bool dequeue(T& data, size_t& pos_out)
+    {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            size_t base = pos & ~segment_mask_;
+            size_t index = (pos / segment_size_) % max_segments_;
+            segment_t* segment = directory_[index].load(std::memory_order_acquire);
+            if (segment && segment->base.load(std::memory_order_acquire) == base)
+            {
+                cell_t& cell = segment->cells[pos & segment_mask_];
+                size_t seq = cell.sequence_.load(std::memory_order_acquire);
+                intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+                if (dif == 0)
+                {
+                    if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        data = std::move(cell.data_);
+                        pos_out = pos;
+                        if (segment->drained.fetch_add(1, std::memory_order_acq_rel) + 1 == segment_size_)
+                        {
+                            // nobody else can touch the slot until the next lap is installed in it
+                            directory_[index].store(nullptr, std::memory_order_release);
+                            release_segment(segment);
+                        }
+                        return true;
+                    }
+                }
+                else if (dif < 0)
+                    return false;
+                else
+                    pos = dequeue_pos_.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            // the segment of pos is not installed yet, so nothing was enqueued there
+            size_t current = dequeue_pos_.load(std::memory_order_relaxed);
+            if (current == pos)
+                return false;
+            pos = current;
+        }
+    }
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    // segments allocated so far, in use or free
+    size_t segments() const
+    {
+        return allocated_.load(std::memory_order_relaxed);
+    }
+
+    // start over empty in a child after fork(), the only thread left: like mpmc_bounded_queue::reset_in_child,
+    // and a segment some producer was installing or retiring at fork() is lost
+    void reset_in_child()
+    {
+        for (size_t i = 0; i != max_segments_; i += 1)
+        {
+            segment_t* segment = directory_[i].exchange(nullptr, std::memory_order_relaxed);
+            if (segment)
+                release_segment(segment);
+        }
+        size_t segments = 0;
+        for (size_t i = 0; i != max_segments_; i += 1)
+        {
+            segment_t* segment = free_[i].load(std::memory_order_relaxed);
+            if (!segment)
+                continue;
+            ++segments;
+            for (size_t c = 0; c != segment_size_; c += 1)
+                new (&segment->cells[c].data_) T();
+        }
+        for (size_t i = 0; i != max_segments_; i += 1)
+            next_base_[i].store(i * segment_size_, std::memory_order_relaxed);
+        allocated_.store(segments, std::memory_order_relaxed);
+        enqueue_pos_.store(0, std::memory_order_relaxed);
+        dequeue_pos_.store(0, std::memory_order_relaxed);
+
+        segment_t* first = acquire_segment();
+        if (!first)
+            throw spdlog_ex("async logger queue could not get a segment after fork");
+        first->reset(0, segment_size_);
+        directory_[0].store(first, std::memory_order_relaxed);
+        next_base_[0].store(capacity_, std::memory_order_relaxed);
+    }
+
+    // number of items enqueued/dequeued so far, and their difference (approximate while in use)
+    size_t enqueued() const
+    {
+        return enqueue_pos_.load(std::memory_order_relaxed);
+    }
+
+    size_t dequeued() const
+    {
+        return dequeue_pos_.load(std::memory_order_relaxed);
+    }
+
+    size_t size_approx() const
+    {
+        // dequeue_pos_ never passes enqueue_pos_, so load it first
+        size_t dequeue_pos = dequeue_pos_.load(std::memory_order_relaxed);
+        return enqueue_pos_.load(std::memory_order_relaxed) - dequeue_pos;
+    }
+
+private:
+    struct cell_t
+    {
+        std::atomic<size_t>   sequence_;
+        T                     data_;
+    };
+
+    struct segment_t
+    {
+        std::atomic<size_t>         base;
+        std::atomic<size_t>         drained;
+        std::unique_ptr<cell_t[]>   cells;
+
+        explicit segment_t(size_t size) : cells(new cell_t[size])
+        {
+            base.store(~size_t(0), std::memory_order_relaxed);
+        }
+
+        // serve the lap starting at position new_base, the base is published last
+        void reset(size_t new_base, size_t size)
+        {
+            drained.store(0, std::memory_order_relaxed);
+            for (size_t i = 0; i != size; i += 1)
+                cells[i].sequence_.store(new_base + i, std::memory_order_relaxed);
+            base.store(new_base, std::memory_order_release);
+        }
+    };
+
+    // claim the lap of base in the slot and install a segment for it.
+    // return false if the previous lap still holds the slot or the ceiling was reached (full),
+    // true to retry (installed, by this thread or another one)
+    bool install(size_t index, size_t base)
+    {
+        size_t expected = base;
+        if (!next_base_[index].compare_exchange_strong(expected, base + capacity_, std::memory_order_acq_rel))
+            return true;
+        segment_t* segment = acquire_segment();
+        if (segment)
+        {
+            segment->reset(base, segment_size_);
+            segment_t* empty = nullptr;
+            if (directory_[index].compare_exchange_strong(empty, segment, std::memory_order_acq_rel))
+                return true;
+            release_segment(segment);
+        }
+        // give the lap back for a later try
+        next_base_[index].store(base, std::memory_order_release);
+        return false;
+    }
+
+    // a free segment, or a new one below the ceiling, or null
+    segment_t* acquire_segment()
+    {
+        for (size_t i = 0; i != max_segments_; i += 1)
+        {
+            if (!free_[i].load(std::memory_order_relaxed))
+                continue;
+            segment_t* segment = free_[i].exchange(nullptr, std::memory_order_acq_rel);
+            if (segment)
+                return segment;
+        }
+        if (allocated_.fetch_add(1, std::memory_order_relaxed) < max_segments_)
+        {
+            try
+            {
+                return new segment_t(segment_size_);
+            }
+            catch (const std::bad_alloc&)
+            {}
+        }
+        allocated_.fetch_sub(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    // there are never more segments than free list slots
+    void release_segment(segment_t* segment)
+    {
+        for (size_t i = 0; i != max_segments_; i += 1)
+        {
+            segment_t* empty = nullptr;
+            if (free_[i].compare_exchange_strong(empty, segment, std::memory_order_acq_rel))
+                return;
+        }
+    }
+
+    static size_t const     cacheline_size = 64;
+    typedef char            cacheline_pad_t [cacheline_size];
+
+    cacheline_pad_t         pad0_;
+    size_t const            segment_size_;
+    size_t const            segment_mask_;
+    size_t const            max_segments_;
+    size_t const            capacity_;
+    std::unique_ptr<std::atomic<segment_t*>[]> directory_;
+    std::unique_ptr<std::atomic<size_t>[]> next_base_;
+    std::unique_ptr<std::atomic<segment_t*>[]> free_;
+    std::atomic<size_t>     allocated_;
+    cacheline_pad_t         pad1_;
+    std::atomic<size_t>     enqueue_pos_;
+    cacheline_pad_t         pad2_;
+    std::atomic<size_t>     dequeue_pos_;
+    cacheline_pad_t         pad3_;
+
+    mpmc_segmented_queue(mpmc_segmented_queue const&);
+    void operator = (mpmc_segmented_queue const&);
+};
+
+} // ns details
+} // ns spdlog
@@ -26,6 +26,7 @@
 #include<string>
 #include<cstdio>
 #include<ctime>
+#include<vector>
 
 #ifdef _WIN32
 # ifndef WIN32_LEAN_AND_MEAN
@@ -40,10 +41,20 @@
 #elif __linux__
 #include <sys/syscall.h> //Use gettid() syscall under linux to get thread id
 #include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <vector>
 #else
 #include <thread>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #endif
 
+#include <cstdlib>
+
 #include "../common.h"
 
 namespace spdlog
@@ -106,6 +117,50 @@ inline std::tm gmtime()
     std::time_t now_t = time(nullptr);
     return gmtime(now_t);
 }
+
+// Convert days since 1970-01-01 to a proleptic gregorian date (month 1-12, day 1-31)
+// Pure integer arithmetic, so it takes no lock and is async signal safe
+// http://howardhinnant.github.io/date_algorithms.html#civil_from_days
+inline void civil_from_days(long long days, int& year, int& month, int& day) SPDLOG_NOEXCEPT
+{
+    days += 719468;
+    const long long era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    day = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    year = static_cast<int>(yoe + era * 400 + (month <= 2));
+}
+
+// broken down time at utc_minutes east of UTC, computed without the libc time zone code. tm_isdst is 0.
+inline std::tm civil_time(std::time_t time_tt, int utc_minutes)
+{
+    long long t = static_cast<long long>(time_tt) + utc_minutes * 60LL;
+    long long days = t / 86400, secs = t % 86400;
+    if (secs < 0)
+    {
+        secs += 86400;
+        --days;
+    }
+
+    std::tm tm = std::tm();
+    tm.tm_sec = static_cast<int>(secs % 60);
+    tm.tm_min = static_cast<int>(secs / 60 % 60);
+    tm.tm_hour = static_cast<int>(secs / 3600);
+    tm.tm_wday = static_cast<int>(days >= -4 ? (days + 4) % 7 : (days + 5) % 7 + 6);
+
+    static const int days_before_month[] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+    int year, month, day;
+    civil_from_days(days, year, month, day);
+    bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    tm.tm_mday = day;
+    tm.tm_mon = month - 1;
+    tm.tm_year = year - 1900;
+    tm.tm_yday = days_before_month[month - 1] + day - 1 + (leap && month > 2);
+    return tm;
+}
 inline bool operator==(const std::tm& tm1, const std::tm& tm2)
 {
     return (tm1.tm_sec == tm2.tm_sec &&
@@ -176,6 +231,135 @@ inline int utc_minutes_offset(const std::tm& tm = details::os::localtime())
 #endif
 }
 
+// Write all bytes to a file descriptor, async signal safe (no-op under windows)
+inline void crash_write(int fd, const char* data, size_t size) SPDLOG_NOEXCEPT
+{
+#ifndef _WIN32
+    while (size > 0)
+    {
+        auto written = ::write(fd, data, size);
+        if (written <= 0)
+            return;
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+#else
+    (void)fd;
+    (void)data;
+    (void)size;
+#endif
+}
+
+// Allocate bytes of page aligned memory, to be released with page_free()
+// With huge_pages, align it on huge pages and advise the kernel to back it with transparent huge pages
+// (linux only, the advice may be ignored). Return null if failed
+inline void* page_alloc(size_t bytes, bool huge_pages)
+{
+#ifdef __linux__
+    const size_t page = huge_pages ? 2 * 1024 * 1024 : static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const size_t size = (bytes + page - 1) / page * page;
+    void* memory = nullptr;
+    if (::posix_memalign(&memory, page, size))
+        return nullptr;
+    if (huge_pages)
+        ::madvise(memory, size, MADV_HUGEPAGE);
+    return memory;
+#else
+    (void)huge_pages;
+    return std::malloc(bytes);
+#endif
+}
+
+inline void page_free(void* memory)
+{
+    std::free(memory);
+}
+
+// Lock the pages of the given memory in RAM, faulting them in
+// Return false if not supported or failed (the locked memory limit is usually low without privileges)
+inline bool lock_pages(const void* memory, size_t bytes)
+{
+#ifndef _WIN32
+    return ::mlock(memory, bytes) == 0;
+#else
+    (void)memory;
+    (void)bytes;
+    return false;
+#endif
+}
+
+// Create a non blocking event file descriptor, readable while signaled
+// Return -1 if not supported or failed
+inline int event_fd()
+{
+#ifdef __linux__
+    return ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    return -1;
+#endif
+}
+
+// Make the event file descriptor readable
+inline void event_fd_signal(int fd)
+{
+#ifdef __linux__
+    if (fd < 0)
+        return;
+    eventfd_t one = 1;
+    ::eventfd_write(fd, one);
+#else
+    (void)fd;
+#endif
+}
+
+// Reset the event file descriptor, it is not readable anymore until signaled again
+inline void event_fd_clear(int fd)
+{
+#ifdef __linux__
+    if (fd < 0)
+        return;
+    eventfd_t value;
+    ::eventfd_read(fd, &value);
+#else
+    (void)fd;
+#endif
+}
+
+// Close an event file descriptor
+inline void event_fd_close(int fd)
+{
+#ifdef __linux__
+    if (fd >= 0)
+        ::close(fd);
+#else
+    (void)fd;
+#endif
+}
+
+// Return the process id
+inline int pid()
+{
+#ifdef _WIN32
+    return static_cast<int>(::GetCurrentProcessId());
+#else
+    return static_cast<int>(::getpid());
+#endif
+}
+
+// Register handlers run around fork() (pthread_atfork)
+// Return false if not supported or failed
+inline bool at_fork(void (*prepare)(), void (*parent)(), void (*child)())
+{
+#ifdef _WIN32
+    (void)prepare;
+    (void)parent;
+    (void)child;
+    return false;
+#else
+    return ::pthread_atfork(prepare, parent, child) == 0;
+#endif
+}
+
 //Return current thread id as size_t
 //It exists because the std::this_thread::get_id() is much slower(espcially under VS 2013)
 inline size_t thread_id()
@@ -190,6 +374,104 @@ inline size_t thread_id()
 
 }
 
+// Pin the current thread to the given cpus
+// Return false if not supported or failed
+inline bool set_thread_affinity(const std::vector<int>& cpus)
+{
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (auto cpu : cpus)
+        CPU_SET(cpu, &cpu_set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+// Set the scheduling policy (SCHED_OTHER, SCHED_FIFO, ...) and priority of the current thread
+// Return false if not supported or failed (real time policies need privileges)
+inline bool set_thread_scheduling(int policy, int priority)
+{
+#ifdef __linux__
+    sched_param param;
+    param.sched_priority = priority;
+    return pthread_setschedparam(pthread_self(), policy, &param) == 0;
+#else
+    (void)policy;
+    (void)priority;
+    return false;
+#endif
+}
+
+// Return the cpu the current thread runs on, or -1 if not supported
+inline int current_cpu()
+{
+#ifdef __linux__
+    return ::sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+// Parse a linux cpu/node list like "0-3,8,10-11"
+inline std::vector<int> parse_id_list(const std::string& list)
+{
+    std::vector<int> ids;
+    size_t pos = 0;
+    while (pos < list.size())
+    {
+        auto end = list.find(',', pos);
+        if (end == std::string::npos)
+            end = list.size();
+        auto range = list.substr(pos, end - pos);
+        int first, last;
+        auto fields = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (fields == 1)
+            last = first;
+        for (int id = first; fields >= 1 && id <= last; ++id)
+            ids.push_back(id);
+        pos = end + 1;
+    }
+    return ids;
+}
+
+// Return the cpus of each NUMA node, from /sys (linux only, empty if not found)
+inline std::vector<std::vector<int>> numa_nodes()
+{
+    std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+    auto read_line = [](const std::string& path)
+    {
+        std::string line;
+        if (auto file = std::fopen(path.c_str(), "r"))
+        {
+            char buf[1024];
+            if (std::fgets(buf, sizeof(buf), file))
+                line = buf;
+            std::fclose(file);
+        }
+        return line;
+    };
+    for (auto node : parse_id_list(read_line("/sys/devices/system/node/online")))
+        nodes.push_back(parse_id_list(read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")));
+#endif
+    return nodes;
+}
+
+// Name the current thread, as shown by top/ps/gdb (truncated to 15 chars under linux)
+// Return false if not supported or failed
+inline bool set_thread_name(const std::string& name)
+{
+#ifdef __linux__
+    return pthread_setname_np(pthread_self(), name.substr(0, 15).c_str()) == 0;
+#else
+    (void)name;
+    return false;
+#endif
+}
+
 } //os
 } //details
 } //spdlog
@@ -25,10 +25,13 @@
 #pragma once
 
 #include <string>
+#include <atomic>
 #include <chrono>
+#include <ctime>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
 #include <vector>
-#include <thread>
 
 
 #include "../formatter.h"
@@ -39,48 +42,11 @@ namespace spdlog
 {
 namespace details
 {
-class flag_formatter
-{
-public:
-    virtual ~flag_formatter() {}
-    virtual void format(details::log_msg& msg, const std::tm& tm_time) = 0;
-};
-
-///////////////////////////////////////////////////////////////////////
-// name & level pattern appenders
-///////////////////////////////////////////////////////////////////////
-namespace
-{
-class name_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm&) override
-    {
-        msg.formatted << msg.logger_name;
-    }
-};
-}
-
-// log level appender
-class level_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm&) override
-    {
-        msg.formatted << level::to_str(msg.level);
-    }
-};
-
-// short log level appender
-class short_level_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm&) override
-    {
-        msg.formatted << level::to_short_str(msg.level);
-    }
-};
 
-///////////////////////////////////////////////////////////////////////
-// Date time pattern appenders
-///////////////////////////////////////////////////////////////////////
+static const char* const days[] { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+static const char* const full_days[] { "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday" };
+static const char* const months[] { "Jan", "Feb", "Mar", "Apr", "May", "June", "July", "Aug", "Sept", "Oct", "Nov", "Dec" };
+static const char* const full_months[] { "January", "February", "March", "April", "May", "June", "July", "August", "September", "October", "November", "December" };
 
 static const char* ampm(const tm& t)
 {
@@ -92,594 +58,531 @@ static int to12h(const tm& t)
     return t.tm_hour > 12 ? t.tm_hour - 12 : t.tm_hour;
 }
 
-//Abbreviated weekday name
-static const std::string days[] { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
-class a_formatter :public flag_formatter
+inline void append(fmt::MemoryWriter& w, const char* s, size_t n)
 {
-    void format(details::log_msg& msg, const std::tm& tm_time) override
-    {
-        msg.formatted << days[tm_time.tm_wday];
-    }
-};
+    w.buffer().append(s, s + n);
+}
 
-//Full weekday name
-static const std::string full_days[] { "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday" };
-class A_formatter :public flag_formatter
+inline void append(fmt::MemoryWriter& w, const char* s)
 {
-    void format(details::log_msg& msg, const std::tm& tm_time) override
-    {
-        msg.formatted << full_days[tm_time.tm_wday];
-    }
-};
+    append(w, s, std::strlen(s));
+}
 
-//Abbreviated month
-static const std::string  months[] { "Jan", "Feb", "Mar", "Apr", "May", "June", "July", "Aug", "Sept", "Oct", "Nov", "Dec" };
-class b_formatter :public flag_formatter
+inline void append(fmt::MemoryWriter& w, char c)
 {
-    void format(details::log_msg& msg, const std::tm& tm_time) override
-    {
-        msg.formatted<< months[tm_time.tm_mon];
-    }
-};
+    w.buffer().push_back(c);
+}
 
-//Full month name
-static const std::string full_months[] { "January", "February", "March", "April", "May", "June", "July", "August", "September", "October", "November", "December" };
-class B_formatter :public flag_formatter
+// decimal digits of v, padded with zeros to at least width digits
+inline void append_digits(fmt::MemoryWriter& w, unsigned long long v, unsigned width)
 {
-    void format(details::log_msg& msg, const std::tm& tm_time) override
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+    do
     {
-        msg.formatted << full_months[tm_time.tm_mon];
+        *--p = static_cast<char>('0' + v % 10);
+        v /= 10;
     }
-};
-
+    while (v);
+    while (static_cast<unsigned>(end - p) < width)
+        *--p = '0';
+    append(w, p, static_cast<size_t>(end - p));
+}
 
-//write 2 ints seperated by sep with padding of 2
-static fmt::MemoryWriter& pad_n_join(fmt::MemoryWriter& w, int v1, int v2, char sep)
+//write 2 or 3 ints seperated by sep with padding of 2
+inline void pad_n_join(fmt::MemoryWriter& w, int v1, int v2, char sep)
 {
-    w << fmt::pad(v1, 2, '0') << sep << fmt::pad(v2, 2, '0');
-    return w;
+    append_digits(w, static_cast<unsigned>(v1), 2);
+    append(w, sep);
+    append_digits(w, static_cast<unsigned>(v2), 2);
 }
 
-//write 3 ints seperated by sep with padding of 2
-static fmt::MemoryWriter& pad_n_join(fmt::MemoryWriter& w, int v1, int v2, int v3, char sep)
+inline void pad_n_join(fmt::MemoryWriter& w, int v1, int v2, int v3, char sep)
 {
-    w << fmt::pad(v1, 2, '0') << sep << fmt::pad(v2, 2, '0') << sep << fmt::pad(v3, 2, '0');
-    return w;
+    pad_n_join(w, v1, v2, sep);
+    append(w, sep);
+    append_digits(w, static_cast<unsigned>(v3), 2);
 }
 
-
-//Date and time representation (Thu Aug 23 15:35:46 2014)
-class c_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm& tm_time) override
-    {
-        msg.formatted << days[tm_time.tm_wday] << ' ' << months[tm_time.tm_mon] << ' ' << tm_time.tm_mday << ' ';
-        pad_n_join(msg.formatted, tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec, ':') << ' ' << tm_time.tm_year + 1900;
+// most bytes written by an op, message fields (logger name, text, file and function names) aside
+inline unsigned op_width(pattern_op::code_t code)
+{
+    switch (code)
+    {
+    case pattern_op::level: return 8;
+    case pattern_op::short_level: return 1;
+    case pattern_op::thread_id: return 20;
+    case pattern_op::file_line: return 10;
+    case pattern_op::weekday: return 3;
+    case pattern_op::full_weekday: return 9;
+    case pattern_op::month_name: return 4;
+    case pattern_op::full_month_name: return 9;
+    case pattern_op::date_time: return 24;
+    case pattern_op::date: return 8;
+    case pattern_op::year: return 4;
+    case pattern_op::year2:
+    case pattern_op::month:
+    case pattern_op::day:
+    case pattern_op::hour:
+    case pattern_op::hour12:
+    case pattern_op::minute:
+    case pattern_op::second:
+    case pattern_op::am_pm: return 2;
+    case pattern_op::time12: return 11;
+    case pattern_op::hour_minute: return 5;
+    case pattern_op::time: return 8;
+    case pattern_op::utc_offset: return 6;
+    case pattern_op::millis: return 3;
+    case pattern_op::micros: return 6;
+    case pattern_op::nanos: return 9;
+    default: return 0;
     }
-};
-
-
-// year - 2 digit
-class C_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm& tm_time) override
-    {
-        msg.formatted << fmt::pad(tm_time.tm_year % 100, 2, '0');
-    }
-};
-
-
+}
 
-// Short MM/DD/YY date, equivalent to %m/%d/%y 08/23/01
-class D_formatter :public flag_formatter
+// write one message, date or time field (any op but literal and second_run)
+inline void write_field(pattern_op::code_t code, log_msg& msg, const zoned_tm& tm_time)
 {
-    void format(details::log_msg& msg, const std::tm& tm_time) override
+    auto& w = msg.formatted;
+    switch (code)
     {
-        pad_n_join(msg.formatted, tm_time.tm_mon + 1, tm_time.tm_mday, tm_time.tm_year % 100, '/');
-    }
-};
-
+    case pattern_op::name:
+        details::append(w, msg.logger_name.data(), msg.logger_name.size());
+        break;
+    case pattern_op::level:
+        details::append(w, level::to_str(msg.level));
+        break;
+    case pattern_op::short_level:
+        details::append(w, level::to_short_str(msg.level));
+        break;
+    case pattern_op::thread_id:
+        details::append_digits(w, msg.thread_id, 1);
+        break;
+    case pattern_op::text:
+        details::append(w, msg.raw.data(), msg.raw.size());
+        break;
+    case pattern_op::file_name:
+        details::append(w, msg.a_msg.file_base_name(), msg.a_msg.file_base_size());
+        break;
+    case pattern_op::file_line:
+        if (msg.a_msg.line_num > 0)
+            details::append_digits(w, static_cast<unsigned>(msg.a_msg.line_num), 1);
+        break;
+    case pattern_op::func_name:
+        details::append(w, msg.a_msg.func_name.data(), msg.a_msg.func_name.size());
+        break;
 
-// year - 4 digit
-class Y_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm& tm_time) override
+    case pattern_op::weekday:
+        details::append(w, details::days[tm_time.tm_wday]);
+        break;
+    case pattern_op::full_weekday:
+        details::append(w, details::full_days[tm_time.tm_wday]);
+        break;
+    case pattern_op::month_name:
+        details::append(w, details::months[tm_time.tm_mon]);
+        break;
+    case pattern_op::full_month_name:
+        details::append(w, details::full_months[tm_time.tm_mon]);
+        break;
+    case pattern_op::date_time: // Thu Aug 23 15:35:46 2014
+        details::append(w, details::days[tm_time.tm_wday]);
+        details::append(w, ' ');
+        details::append(w, details::months[tm_time.tm_mon]);
+        details::append(w, ' ');
+        details::append_digits(w, static_cast<unsigned>(tm_time.tm_mday), 1);
+        details::append(w, ' ');
+        details::pad_n_join(w, tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec, ':');
+        details::append(w, ' ');
+        details::append_digits(w, static_cast<unsigned>(tm_time.tm_year + 1900), 1);
+        break;
+    case pattern_op::year2:
+        details::append_digits(w, static_cast<unsigned>(tm_time.tm_year % 100), 2);
+        break;
+    case pattern_op::date: // 08/23/01
+        details::pad_n_join(w, tm_time.tm_mon + 1, tm_time.tm_mday, tm_time.tm_year % 100, '/');
+        break;
+    case pattern_op::year:
+        details::append_digits(w, static_cast<unsigned>(tm_time.tm_year + 1900), 1);
+        break;
+    case pattern_op::month:
+        details::append_digits(w, static_cast<unsigned>(tm_time.tm_mon + 1), 2);
+        break;
+    case pattern_op::day:
+        details::append_digits(w, static_cast<unsigned>(tm_time.tm_mday), 2);
+        break;
+    case pattern_op::hour:
+        details::append_digits(w, static_cast<unsigned>(tm_time.tm_hour), 2);
+        break;
+    case pattern_op::hour12:
+        details::append_digits(w, static_cast<unsigned>(details::to12h(tm_time)), 2);
+        break;
+    case pattern_op::minute:
+        details::append_digits(w, static_cast<unsigned>(tm_time.tm_min), 2);
+        break;
+    case pattern_op::second:
+        details::append_digits(w, static_cast<unsigned>(tm_time.tm_sec), 2);
+        break;
+    case pattern_op::am_pm:
+        details::append(w, details::ampm(tm_time), 2);
+        break;
+    case pattern_op::time12: // 02:55:02 PM
+        details::pad_n_join(w, details::to12h(tm_time), tm_time.tm_min, tm_time.tm_sec, ':');
+        details::append(w, ' ');
+        details::append(w, details::ampm(tm_time), 2);
+        break;
+    case pattern_op::hour_minute:
+        details::pad_n_join(w, tm_time.tm_hour, tm_time.tm_min, ':');
+        break;
+    case pattern_op::time:
+        details::pad_n_join(w, tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec, ':');
+        break;
+    case pattern_op::utc_offset: // +-HH:MM
     {
-        msg.formatted << tm_time.tm_year + 1900;
+        int total_minutes = tm_time.utc_minutes;
+        details::append(w, total_minutes >= 0 ? '+' : '-');
+        total_minutes = std::abs(total_minutes);
+        details::pad_n_join(w, total_minutes / 60, total_minutes % 60, ':');
+        break;
     }
-};
 
-// month 1-12
-class m_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm& tm_time) override
+    case pattern_op::millis:
     {
-        msg.formatted << fmt::pad(tm_time.tm_mon + 1, 2, '0');
+        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(msg.time.time_since_epoch()).count() % 1000;
+        details::append_digits(w, static_cast<unsigned>(millis), 3);
+        break;
     }
-};
-
-// day of month 1-31
-class d_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm& tm_time) override
+    case pattern_op::micros:
     {
-        msg.formatted << fmt::pad(tm_time.tm_mday, 2, '0');
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(msg.time.time_since_epoch()).count() % 1000000;
+        details::append_digits(w, static_cast<unsigned>(micros), 6);
+        break;
     }
-};
-
-// hours in 24 format  0-23
-class H_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm& tm_time) override
+    case pattern_op::nanos:
     {
-        msg.formatted << fmt::pad(tm_time.tm_hour, 2, '0');
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(msg.time.time_since_epoch()).count() % 1000000000;
+        details::append_digits(w, static_cast<unsigned>(ns), 9);
+        break;
     }
-};
-
-// hours in 12 format  1-12
-class I_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm& tm_time) override
-    {
-        msg.formatted << fmt::pad(to12h(tm_time), 2, '0');
+    default:
+        break;
     }
-};
+}
 
-// ninutes 0-59
-class M_formatter :public flag_formatter
+// copy the run as rendered for this second, first rendering it with render() if it is older
+template<typename Render>
+inline void write_second_run(second_run& run, log_msg& msg, const Render& render)
 {
-    void format(details::log_msg& msg, const std::tm& tm_time) override
+    if (run.busy.test_and_set(std::memory_order_acquire))
     {
-        msg.formatted << fmt::pad(tm_time.tm_min, 2, '0');
+        render();
+        return;
     }
-};
-
-// seconds 0-59
-class S_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm& tm_time) override
+    struct release
     {
-        msg.formatted << fmt::pad(tm_time.tm_sec, 2, '0');
-    }
-};
+        std::atomic_flag& busy;
+        ~release()
+        {
+            busy.clear(std::memory_order_release);
+        }
+    } guard{ run.busy };
 
-// milliseconds
-class e_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm&) override
+    auto& w = msg.formatted;
+    auto second = log_clock::to_time_t(msg.time);
+    if (run.valid && second == run.second)
     {
-        auto duration = msg.time.time_since_epoch();
-        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count() % 1000;
-        msg.formatted << fmt::pad(static_cast<int>(millis), 3, '0');
+        details::append(w, run.rendered.data(), run.rendered.size());
+        return;
     }
-};
+    auto begin = w.size();
+    render();
+    run.rendered.assign(w.data() + begin, w.size() - begin);
+    run.second = second;
+    run.valid = true;
+}
 
-// microseconds
-class f_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm&) override
-    {
-        auto duration = msg.time.time_since_epoch();
-        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count() % 1000000;
-        msg.formatted << fmt::pad(static_cast<int>(micros), 6, '0');
+// write_field() cut to max_size bytes (0: no limit) without splitting a UTF-8 sequence, then padded with
+// spaces to pad_width bytes, on the left unless left_align. In place, moving the field if padded on the left.
+inline void write_field(pattern_op::code_t code, log_msg& msg, const zoned_tm& tm_time,
+                        unsigned pad_width, unsigned max_size, bool left_align)
+{
+    auto& buf = msg.formatted.buffer();
+    size_t begin = buf.size();
+    write_field(code, msg, tm_time);
+    size_t size = buf.size() - begin;
+    if (max_size && size > max_size)
+    {
+        size = max_size;
+        while (size && (static_cast<unsigned char>(buf[begin + size]) & 0xc0) == 0x80)
+            --size;
+        buf.resize(begin + size);
+    }
+    if (size >= pad_width)
+        return;
+    size_t pad = pad_width - size;
+    buf.resize(begin + pad_width);
+    char* field = &buf[begin];
+    if (left_align)
+        std::memset(field + size, ' ', pad);
+    else
+    {
+        std::memmove(field + pad, field, size);
+        std::memset(field, ' ', pad);
     }
-};
+}
 
-// nanoseconds
-class F_formatter :public flag_formatter
+// parse the modifiers of a flag (see field_spec) from it, return where the flag is (or end)
+template<typename It>
+inline It parse_field_spec(It it, It end, field_spec& spec)
 {
-    void format(details::log_msg& msg, const std::tm&) override
+    if (it != end && *it == '-')
     {
-        auto duration = msg.time.time_since_epoch();
-        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() % 1000000000;
-        msg.formatted << fmt::pad(static_cast<int>(ns), 9, '0');
+        spec.left_align = true;
+        ++it;
     }
-};
-
-// AM/PM
-class p_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm& tm_time) override
+    for (; it != end && *it >= '0' && *it <= '9'; ++it)
+        spec.pad_width = spec.pad_width * 10 + static_cast<unsigned>(*it - '0');
+    if (it != end && *it == '.')
     {
-        msg.formatted << ampm(tm_time);
+        for (++it; it != end && *it >= '0' && *it <= '9'; ++it)
+            spec.max_size = spec.max_size * 10 + static_cast<unsigned>(*it - '0');
     }
-};
+    return it;
+}
 
+// the op of a flag following '%' (or '#' if new_defined), literal if unknown
+constexpr pattern_op::code_t flag_code(char flag, bool new_defined = false)
+{
+    return new_defined ? (flag == 'f' ? pattern_op::file_name :
+                          flag == 'l' ? pattern_op::file_line :
+                          flag == 'F' ? pattern_op::func_name : pattern_op::literal) :
+           flag == 'n' ? pattern_op::name :
+           flag == 'l' ? pattern_op::level :
+           flag == 'L' ? pattern_op::short_level :
+           flag == 't' ? pattern_op::thread_id :
+           flag == 'v' ? pattern_op::text :
+           flag == 'a' ? pattern_op::weekday :
+           flag == 'A' ? pattern_op::full_weekday :
+           flag == 'b' || flag == 'h' ? pattern_op::month_name :
+           flag == 'B' ? pattern_op::full_month_name :
+           flag == 'c' ? pattern_op::date_time :
+           flag == 'C' ? pattern_op::year2 :
+           flag == 'Y' ? pattern_op::year :
+           flag == 'D' || flag == 'x' ? pattern_op::date :
+           flag == 'm' ? pattern_op::month :
+           flag == 'd' ? pattern_op::day :
+           flag == 'H' ? pattern_op::hour :
+           flag == 'I' ? pattern_op::hour12 :
+           flag == 'M' ? pattern_op::minute :
+           flag == 'S' ? pattern_op::second :
+           flag == 'e' ? pattern_op::millis :
+           flag == 'f' ? pattern_op::micros :
+           flag == 'F' ? pattern_op::nanos :
+           flag == 'p' ? pattern_op::am_pm :
+           flag == 'r' ? pattern_op::time12 :
+           flag == 'R' ? pattern_op::hour_minute :
+           flag == 'T' || flag == 'X' ? pattern_op::time :
+           flag == 'z' ? pattern_op::utc_offset : pattern_op::literal;
+}
 
-// 12 hour clock 02:55:02 pm
-class r_formatter :public flag_formatter
+inline zoned_tm tm_cache::convert(std::time_t second) const
 {
-    void format(details::log_msg& msg, const std::tm& tm_time) override
+    zoned_tm tm_time;
+    if (_tz.local)
     {
-        pad_n_join(msg.formatted, to12h(tm_time), tm_time.tm_min, tm_time.tm_sec, ':') << ' ' << ampm(tm_time);
+        static_cast<std::tm&>(tm_time) = os::localtime(second);
+        tm_time.utc_minutes = os::utc_minutes_offset(tm_time);
     }
-};
-
-// 24-hour HH:MM time, equivalent to %H:%M
-class R_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm& tm_time) override
+    else
     {
-        pad_n_join(msg.formatted, tm_time.tm_hour, tm_time.tm_min, ':');
+        static_cast<std::tm&>(tm_time) = os::civil_time(second, _tz.utc_minutes);
+        tm_time.utc_minutes = _tz.utc_minutes;
     }
-};
+    return tm_time;
+}
 
-// ISO 8601 time format (HH:MM:SS), equivalent to %H:%M:%S
-class T_formatter :public flag_formatter
+// localtime() takes the libc timezone lock, call it once per second (or when another thread holds the cache)
+inline zoned_tm tm_cache::get(std::time_t second)
 {
-    void format(details::log_msg& msg, const std::tm& tm_time) override
+    if (_busy.test_and_set(std::memory_order_acquire))
+        return convert(second);
+    if (!_valid || second != _second)
     {
-        pad_n_join(msg.formatted, tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec, ':');
+        _tm = convert(second);
+        _second = second;
+        _valid = true;
     }
-};
-
+    auto tm_time = _tm;
+    _busy.clear(std::memory_order_release);
+    return tm_time;
+}
 
-// ISO 8601 offset from UTC in timezone (+-HH:MM)
-class z_formatter :public flag_formatter
+}
+}
+///////////////////////////////////////////////////////////////////////////////
+// pattern_formatter inline impl
+///////////////////////////////////////////////////////////////////////////////
+inline spdlog::pattern_formatter::pattern_formatter(const std::string& pattern, const time_zone& tz) :
+    _time(tz)
 {
-public:
-    const std::chrono::seconds cache_refresh = std::chrono::seconds(5);
-
-    z_formatter() :_last_update(std::chrono::seconds(0)) {}
-    z_formatter(const z_formatter&) = delete;
-    z_formatter& operator=(const z_formatter&) = delete;
-
-    void format(details::log_msg& msg, const std::tm& tm_time) override
-    {
-#ifdef _WIN32
-        int total_minutes = get_cached_offset(msg, tm_time);
-#else
-        // No need to chache under gcc,
-        // it is very fast (already stored in tm.tm_gmtoff)
-        int total_minutes = os::utc_minutes_offset(tm_time);
-#endif
-
-        int h = total_minutes / 60;
-        int m = total_minutes % 60;
-        char sign = h >= 0 ? '+' : '-';
-        msg.formatted << sign;
-        pad_n_join(msg.formatted, h, m, ':');
-    }
-private:
-    log_clock::time_point _last_update;
-    int _offset_minutes;
-    std::mutex _mutex;
+    compile_pattern(pattern);
+    group_second_runs();
+}
 
-    int get_cached_offset(const log_msg& msg, const std::tm& tm_time)
+inline void spdlog::pattern_formatter::compile_pattern(const std::string& pattern)
+{
+    auto end = pattern.end();
+    for (auto it = pattern.begin(); it != end; ++it)
     {
-        using namespace std::chrono;
-        std::lock_guard<std::mutex> l(_mutex);
-        if (msg.time - _last_update >= cache_refresh)
+        bool new_defined = *it == '#';
+        if (*it != '%' && !(new_defined && (it + 1) != end && *(it + 1) != '#'))
         {
-            _offset_minutes = os::utc_minutes_offset(tm_time);
-            _last_update = msg.time;
+            // chars not following the % sign should be displayed as is
+            add_literal(&*it, 1);
+            continue;
         }
-        return _offset_minutes;
-    }
-};
-
-
-
-//Thread id
-class t_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm&) override
-    {
-        msg.formatted << msg.thread_id;
-    }
-};
-
-
-class v_formatter :public flag_formatter
-{
-    void format(details::log_msg& msg, const std::tm&) override
-    {
-        msg.formatted << fmt::StringRef(msg.raw.data(), msg.raw.size());
-    }
-};
-
-class ch_formatter :public flag_formatter
-{
-public:
-    explicit ch_formatter(char ch) : _ch(ch)
-    {}
-    void format(details::log_msg& msg, const std::tm&) override
-    {
-        msg.formatted << _ch;
-    }
-private:
-    char _ch;
-};
-
-
-//aggregate user chars to display as is
-class aggregate_formatter :public flag_formatter
-{
-public:
-    aggregate_formatter()
-    {}
-    void add_ch(char ch)
-    {
-        _str += ch;
-    }
-    void format(details::log_msg& msg, const std::tm&) override
-    {
-        msg.formatted << _str;
-    }
-private:
-    std::string _str;
-};
-
-// new defined filename flag
-class filename_formatter :public flag_formatter
-{
-public:
-    void format(details::log_msg& msg, const std::tm&) override
-    {
-        size_t found = msg.a_msg.file_name.find_last_of("(/\\");
-        msg.formatted << msg.a_msg.file_name.substr(found + 1);
+        auto marker = it;
+        details::field_spec spec;
+        it = details::parse_field_spec(it + 1, end, spec);
+        // modifiers of a new defined flag may follow '%' too, like %.30#F
+        if (!new_defined && it != marker + 1 && it != end && *it == '#' && it + 1 != end)
+        {
+            new_defined = true;
+            ++it;
+        }
+        if (it == end)
+        {
+            // a '%' ending the pattern is dropped, unfinished modifiers appear as is
+            if (marker + 1 != end)
+                add_literal(&*marker, static_cast<size_t>(end - marker));
+            break;
+        }
+        if (!(new_defined ? handle_new_defined_flag(*it, spec) : handle_flag(*it, spec)))
+            add_literal(&*marker, static_cast<size_t>(it - marker) + 1); //Unkown flag appears as is
     }
-};
+}
 
-// new defined fileline flag
-class fileline_formatter :public flag_formatter
-{
-public:
-    void format(details::log_msg& msg, const std::tm&) override
-    {
-        if (msg.a_msg.line_num > 0)
-            msg.formatted << msg.a_msg.line_num;
-    }
-};
+inline void spdlog::pattern_formatter::add_op(details::pattern_op::code_t code, const details::field_spec& spec)
+{
+    details::pattern_op op;
+    op.code = code;
+    op.width = details::op_width(code) + spec.pad_width;
+    op.offset = 0;
+    op.size = 0;
+    op.spec = spec;
+    _ops.push_back(op);
+    _reserve += op.width;
+    _name_ops += code == details::pattern_op::name;
+    _text_ops += code == details::pattern_op::text;
+    _file_ops += code == details::pattern_op::file_name;
+    _func_ops += code == details::pattern_op::func_name;
+}
 
-// new defined funcname flag
-class funcname_formatter :public flag_formatter
+// adjacent literals are fused into one op
+inline void spdlog::pattern_formatter::add_literal(const char* s, size_t n)
 {
-public:
-    void format(details::log_msg& msg, const std::tm&) override
+    if (_ops.empty() || _ops.back().code != details::pattern_op::literal)
     {
-        msg.formatted << msg.a_msg.func_name;
+        add_op(details::pattern_op::literal);
+        _ops.back().offset = _literals.size();
     }
-};
+    _literals.append(s, n);
+    _ops.back().size += n;
+    _ops.back().width += static_cast<unsigned>(n);
+    _reserve += n;
+}
 
-// Full info formatter
-// pattern: [%Y-%m-%d %H:%M:%S.%e] [%n] [%l] %v
-class full_formatter :public flag_formatter
+inline bool spdlog::pattern_formatter::handle_flag(char flag, const details::field_spec& spec)
 {
-    void format(details::log_msg& msg, const std::tm& tm_time) override
+    if (flag == '+') // [%Y-%m-%d %H:%M:%S.%e] [%n] [%l] %v, modifiers ignored
     {
 #ifndef SPDLOG_NO_DATETIME
-        auto duration = msg.time.time_since_epoch();
-        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count() % 1000;
-
-        /* Slower version(while still very fast - about 3.2 million lines/sec under 10 threads),
-        msg.formatted.write("[{:d}-{:02d}-{:02d} {:02d}:{:02d}:{:02d}.{:03d}] [{}] [{}] {} ",
-        tm_time.tm_year + 1900,
-        tm_time.tm_mon + 1,
-        tm_time.tm_mday,
-        tm_time.tm_hour,
-        tm_time.tm_min,
-        tm_time.tm_sec,
-        static_cast<int>(millis),
-        msg.logger_name,
-        level::to_str(msg.level),
-        msg.raw.str());*/
-
-
-        // Faster (albeit uglier) way to format the line (5.6 million lines/sec under 10 threads)
-        msg.formatted << '[' << static_cast<unsigned int>(tm_time.tm_year + 1900) << '-'
-                      << fmt::pad(static_cast<unsigned int>(tm_time.tm_mon + 1), 2, '0') << '-'
-                      << fmt::pad(static_cast<unsigned int>(tm_time.tm_mday), 2, '0') << ' '
-                      << fmt::pad(static_cast<unsigned int>(tm_time.tm_hour), 2, '0') << ':'
-                      << fmt::pad(static_cast<unsigned int>(tm_time.tm_min), 2, '0') << ':'
-                      << fmt::pad(static_cast<unsigned int>(tm_time.tm_sec), 2, '0') << '.'
-                      << fmt::pad(static_cast<unsigned int>(millis), 3, '0') << "] ";
-
-//no datetime needed
-#else
-        (void)tm_time;
+        compile_pattern("[%Y-%m-%d %H:%M:%S.%e] ");
 #endif
-
 #ifndef SPDLOG_NO_NAME
-        msg.formatted << '[' << msg.logger_name << "] ";
+        compile_pattern("[%n] ");
 #endif
-
-        msg.formatted << '[' << level::to_str(msg.level) << "] ";
-        msg.formatted << fmt::StringRef(msg.raw.data(), msg.raw.size());
-    }
-};
-
+        compile_pattern("[%l] %v");
+        return true;
+    }
+    auto code = details::flag_code(flag);
+    if (code == details::pattern_op::literal)
+        return false;
+    add_op(code, spec);
+    return true;
 }
-}
-///////////////////////////////////////////////////////////////////////////////
-// pattern_formatter inline impl
-///////////////////////////////////////////////////////////////////////////////
-inline spdlog::pattern_formatter::pattern_formatter(const std::string& pattern)
+
+inline bool spdlog::pattern_formatter::handle_new_defined_flag(char flag, const details::field_spec& spec)
 {
-    compile_pattern(pattern);
+    auto code = details::flag_code(flag, true);
+    if (code == details::pattern_op::literal)
+        return false;
+    add_op(code, spec);
+    return true;
 }
 
-inline void spdlog::pattern_formatter::compile_pattern(const std::string& pattern)
+// cache the runs of date and time fields, with the fixed text around them, per second
+inline void spdlog::pattern_formatter::group_second_runs()
 {
-    auto end = pattern.end();
-    std::unique_ptr<details::aggregate_formatter> user_chars;
-    for (auto it = pattern.begin(); it != end; ++it)
+    std::vector<details::pattern_op> ops;
+    for (size_t i = 0; i < _ops.size();)
     {
-        if (*it == '%')
+        size_t end = i, fields = 0;
+        for (; end < _ops.size() && _ops[end].per_second(); ++end)
         {
-            if (user_chars) //append user chars found so far
-                _formatters.push_back(std::move(user_chars));
-
-            if (++it != end)
-                handle_flag(*it);
-            else
-                break;
+            if (_ops[end].code != details::pattern_op::literal)
+                ++fields;
         }
-        else if (*it == '#' && (it + 1) != end && *(it + 1) != '#')
+        if (fields == 0)
         {
-            if (user_chars) //append user chars found so far
-                _formatters.push_back(std::move(user_chars));
-
-            if (++it != end)
-                handle_new_defined_flag(*it);
-            else
-                break;
+            ops.push_back(_ops[i++]);
+            continue;
         }
-        else // chars not following the % sign should be displayed as is
+        std::unique_ptr<details::second_run> run(new details::second_run());
+        details::pattern_op op;
+        op.code = details::pattern_op::second_run;
+        op.width = 0;
+        op.offset = _runs.size();
+        op.size = 0;
+        for (; i < end; ++i)
         {
-            if (!user_chars)
-                user_chars = std::unique_ptr<details::aggregate_formatter>(new details::aggregate_formatter());
-            user_chars->add_ch(*it);
+            run->ops.push_back(_ops[i]);
+            op.width += _ops[i].width;
         }
+        _runs.push_back(std::move(run));
+        ops.push_back(op);
     }
-    if (user_chars) //append raw chars found so far
-    {
-        _formatters.push_back(std::move(user_chars));
-    }
-
+    _ops = std::move(ops);
 }
-inline void spdlog::pattern_formatter::handle_flag(char flag)
+
+inline void spdlog::pattern_formatter::run(const std::vector<details::pattern_op>& ops, details::log_msg& msg, const details::zoned_tm& tm_time)
 {
-    switch (flag)
+    using details::pattern_op;
+    auto& w = msg.formatted;
+    for (auto& op : ops)
     {
-    // logger name
-    case 'n':
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::name_formatter()));
-        break;
-
-    case 'l':
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::level_formatter()));
-        break;
-
-    case 'L':
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::short_level_formatter()));
-        break;
-
-    case('t') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::t_formatter()));
-        break;
-
-    case('v') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::v_formatter()));
-        break;
-
-    case('a') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::a_formatter()));
-        break;
-
-    case('A') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::A_formatter()));
-        break;
-
-    case('b') :
-    case('h') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::b_formatter()));
-        break;
-
-    case('B') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::B_formatter()));
-        break;
-    case('c') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::c_formatter()));
-        break;
-
-    case('C') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::C_formatter()));
-        break;
-
-    case('Y') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::Y_formatter()));
-        break;
-
-    case('D') :
-    case('x') :
-
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::D_formatter()));
-        break;
-
-    case('m') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::m_formatter()));
-        break;
-
-    case('d') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::d_formatter()));
-        break;
-
-    case('H') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::H_formatter()));
-        break;
-
-    case('I') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::I_formatter()));
-        break;
-
-    case('M') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::M_formatter()));
-        break;
-
-    case('S') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::S_formatter()));
-        break;
-
-    case('e') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::e_formatter()));
-        break;
-
-    case('f') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::f_formatter()));
-        break;
-    case('F') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::F_formatter()));
-        break;
-
-    case('p') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::p_formatter()));
-        break;
-
-    case('r') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::r_formatter()));
-        break;
-
-    case('R') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::R_formatter()));
-        break;
-
-    case('T') :
-    case('X') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::T_formatter()));
-        break;
-
-    case('z') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::z_formatter()));
-        break;
+        switch (op.code)
+        {
+        case pattern_op::literal:
+            details::append(w, _literals.data() + op.offset, op.size);
+            break;
 
-    case ('+'):
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::full_formatter()));
-        break;
+        case pattern_op::second_run:
+        {
+            auto& run = *_runs[op.offset];
+            details::write_second_run(run, msg, [&]
+            {
+                this->run(run.ops, msg, tm_time);
+            });
+            break;
+        }
 
-    default: //Unkown flag appears as is
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::ch_formatter('%')));
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::ch_formatter(flag)));
-        break;
-    }
-}
-inline void spdlog::pattern_formatter::handle_new_defined_flag(char flag)
-{
-    switch (flag)
-    {
-    case ('f') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::filename_formatter()));
-        break;
-    case ('l') :
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::fileline_formatter()));
-        break;
-    case ('F'):
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::funcname_formatter()));
-        break;
-    default: //Unkown flag appears as is
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::ch_formatter('#')));
-        _formatters.push_back(std::unique_ptr<details::flag_formatter>(new details::ch_formatter(flag)));
-        break;
+        default:
+            if (op.spec.any())
+                details::write_field(op.code, msg, tm_time, op.spec.pad_width, op.spec.max_size, op.spec.left_align);
+            else
+                details::write_field(op.code, msg, tm_time);
+            break;
+        }
     }
 }
 
@@ -687,13 +590,14 @@ inline void spdlog::pattern_formatter::format(details::log_msg& msg)
 {
     try
     {
-        auto tm_time = details::os::localtime(log_clock::to_time_t(msg.time));
-        for (auto &f : _formatters)
-        {
-            f->format(msg, tm_time);
-        }
+        auto tm_time = _time.get(log_clock::to_time_t(msg.time));
+        // room for the whole line at once
+        msg.formatted.buffer().reserve(msg.formatted.size() + _reserve + details::os::eol_size() +
+                                       _name_ops * msg.logger_name.size() + _text_ops * msg.raw.size() +
+                                       _file_ops * msg.a_msg.file_name.size() + _func_ops * msg.a_msg.func_name.size());
+        run(_ops, msg, tm_time);
         //write eol
-        msg.formatted << details::os::eol();
+        details::append(msg.formatted, details::os::eol(), details::os::eol_size());
     }
     catch(const fmt::FormatError& e)
     {
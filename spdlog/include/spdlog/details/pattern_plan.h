@@ -0,0 +1,122 @@
+/*************************************************************************/
+/* spdlog - an extremely fast and easy to use c++11 logging library.     */
+/* Copyright (c) 2014 Gabi Melman.                                       */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+#pragma once
+
+// A compiled pattern: a flat array of ops, run by pattern_formatter::run() with one switch per op.
+// Literal text is fused into one op per run of characters, kept together in the formatter's literals.
+
+#include <atomic>
+#include <ctime>
+#include <string>
+#include <vector>
+#include "../common.h"
+
+namespace spdlog
+{
+namespace details
+{
+
+// modifiers between a flag and its marker, like %-8l or %.30#F: '-' to align left, the least width
+// (padding with spaces, on the left unless aligned left), '.' and the most bytes (0: no limit)
+struct field_spec
+{
+    bool left_align = false;
+    unsigned pad_width = 0;
+    unsigned max_size = 0;
+
+    bool any() const
+    {
+        return pad_width || max_size;
+    }
+};
+
+struct pattern_op
+{
+    enum code_t : unsigned char
+    {
+        literal,        // offset/size in the literals
+        second_run,     // offset: index of the second_run
+        // message fields
+        name, level, short_level, thread_id, text, file_name, file_line, func_name,
+        // date and time fields, only changing with the second
+        weekday, full_weekday, month_name, full_month_name, date_time, year2, date, year, month, day,
+        hour, hour12, minute, second, am_pm, time12, hour_minute, time, utc_offset,
+        // sub-second fields
+        millis, micros, nanos
+    };
+
+    code_t code;
+    unsigned width;     // most bytes written, not counting the message fields (for reserving the output)
+    size_t offset;
+    size_t size;
+    field_spec spec;
+
+    static constexpr bool per_second_field(code_t code)
+    {
+        return code >= weekday && code <= utc_offset;
+    }
+
+    bool per_second() const
+    {
+        return code == literal || per_second_field(code);
+    }
+};
+
+// a run of per second ops (like "[%Y-%m-%d %H:%M:%S."), rendered once per second then copied.
+// formatters may be shared by threads: one finding another refreshing the cache renders the run itself.
+struct second_run
+{
+    std::vector<pattern_op> ops;
+    std::atomic_flag busy = ATOMIC_FLAG_INIT;
+    bool valid = false;     // every time_t is a second, -1 included
+    std::time_t second = 0;
+    std::string rendered;
+};
+
+// a broken down time and its offset from UTC in minutes
+struct zoned_tm : std::tm
+{
+    int utc_minutes;
+};
+
+// the zoned_tm of the last second asked for, in a time zone
+class tm_cache
+{
+public:
+    explicit tm_cache(const time_zone& tz) : _tz(tz) {}
+    zoned_tm get(std::time_t second);
+
+private:
+    zoned_tm convert(std::time_t second) const;
+
+    const time_zone _tz;
+    std::atomic_flag _busy = ATOMIC_FLAG_INIT;
+    bool _valid = false;
+    std::time_t _second = 0;
+    zoned_tm _tm;
+};
+
+}
+}
@@ -32,10 +32,12 @@
 #include <mutex>
 #include <unordered_map>
 #include <functional>
+#include <vector>
 
 #include "./null_mutex.h"
 #include "../logger.h"
 #include "../async_logger.h"
+#include "../shm_logger.h"
 #include "../common.h"
 
 namespace spdlog
@@ -70,7 +72,7 @@ public:
 
 
         if (_async_mode)
-            new_logger = std::make_shared<async_logger>(logger_name, sinks_begin, sinks_end, _async_q_size, _overflow_policy, _worker_warmup_cb, _flush_interval_ms);
+            new_logger = std::make_shared<async_logger>(logger_name, sinks_begin, sinks_end, _async_q_size, _overflow_policy, _worker_warmup_cb, _flush_interval_ms, _async_options);
         else
             new_logger = std::make_shared<logger>(logger_name, sinks_begin, sinks_end);
 
@@ -82,6 +84,37 @@ public:
         return new_logger;
     }
 
+    void apply_all(std::function<void(std::shared_ptr<logger>)> fun)
+    {
+        std::lock_guard<Mutex> lock(_mutex);
+        for (auto &l : _loggers)
+            fun(l.second);
+    }
+
+    // the registered loggers, leaving the registry locked until fork_unlock(): the fork handler holds it
+    // across fork(), so the child never inherits it locked by another thread
+    std::vector<std::shared_ptr<logger>> fork_lock()
+    {
+        _mutex.lock();
+        std::vector<std::shared_ptr<logger>> result;
+        try
+        {
+            for (auto &l : _loggers)
+                result.push_back(l.second);
+        }
+        catch (...)
+        {
+            _mutex.unlock();
+            throw;
+        }
+        return result;
+    }
+
+    void fork_unlock()
+    {
+        _mutex.unlock();
+    }
+
     void drop(const std::string& logger_name)
     {
         std::lock_guard<Mutex> lock(_mutex);
@@ -128,7 +161,7 @@ public:
         _level = log_level;
     }
 
-    void set_async_mode(size_t q_size, const async_overflow_policy overflow_policy, const std::function<void()>& worker_warmup_cb, const std::chrono::milliseconds& flush_interval_ms)
+    void set_async_mode(size_t q_size, const async_overflow_policy overflow_policy, const std::function<void()>& worker_warmup_cb, const std::chrono::milliseconds& flush_interval_ms, const async_options& options)
     {
         std::lock_guard<Mutex> lock(_mutex);
         _async_mode = true;
@@ -136,6 +169,7 @@ public:
         _overflow_policy = overflow_policy;
         _worker_warmup_cb = worker_warmup_cb;
         _flush_interval_ms = flush_interval_ms;
+        _async_options = options;
     }
 
     void set_sync_mode()
@@ -170,6 +204,7 @@ private:
     async_overflow_policy _overflow_policy = async_overflow_policy::block_retry;
     std::function<void()> _worker_warmup_cb = nullptr;
     std::chrono::milliseconds _flush_interval_ms;
+    async_options _async_options;
 };
 #ifdef SPDLOG_NO_REGISTRY_MUTEX
 typedef registry_t<spdlog::details::null_mutex> registry;
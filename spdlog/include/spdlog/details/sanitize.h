@@ -0,0 +1,189 @@
+/*************************************************************************/
+/* spdlog - an extremely fast and easy to use c++11 logging library.     */
+/* Copyright (c) 2014 Gabi Melman.                                       */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+// Sanitizing of the text of a message (log_msg::raw) for loggers with a sanitize_mode other than none:
+// control bytes (newlines and ANSI escapes included) and the bytes of invalid UTF-8 sequences are escaped
+// or replaced, so a message can't forge other lines or feed broken UTF-8 to what reads the logs. Escaping
+// also doubles backslashes, so an escape the message itself holds can't pass for one of ours.
+//
+// Printable ASCII is skipped 16 bytes at a time with SSE2, valid multibyte sequences are checked one by one.
+// A clean message is left untouched.
+
+#pragma once
+
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#define SPDLOG_SANITIZE_SSE2
+#endif
+
+#include "../common.h"
+#include "./format.h"
+
+namespace spdlog
+{
+namespace details
+{
+
+// offset of the first byte of s[0, n) that is not printable ASCII, or a backslash if backslash, n if none.
+// with SSE2, a byte is flagged if it is below 0x20 as a signed char (controls and bytes from 0x80) or 0x7f.
+inline size_t ascii_clean_run(const char* s, size_t n, bool backslash)
+{
+    size_t i = 0;
+#ifdef SPDLOG_SANITIZE_SSE2
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    // never matches when backslashes are let through
+    const __m128i slash = _mm_set1_epi8(backslash ? '\\' : 0x7f);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i other = _mm_or_si128(_mm_cmpeq_epi8(bytes, del), _mm_cmpeq_epi8(bytes, slash));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmplt_epi8(bytes, space), other));
+        if (mask)
+        {
+#ifdef _MSC_VER
+            unsigned long first;
+            _BitScanForward(&first, static_cast<unsigned long>(mask));
+            return i + first;
+#else
+            return i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+#endif
+        }
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c < 0x20 || c >= 0x7f || (backslash && c == '\\'))
+            return i;
+    }
+    return n;
+}
+
+// size of the well formed UTF-8 sequence starting s[0, n) (s[0] from 0x80), 0 if there is none:
+// no overlong forms, surrogates or code points above U+10FFFF
+inline size_t utf8_sequence(const char* s, size_t n)
+{
+    auto c = static_cast<unsigned char>(s[0]);
+    unsigned char lo = 0x80, hi = 0xbf;    // range of the second byte
+    size_t len;
+    if (c >= 0xc2 && c <= 0xdf)
+        len = 2;
+    else if (c >= 0xe0 && c <= 0xef)
+    {
+        len = 3;
+        if (c == 0xe0)
+            lo = 0xa0;
+        else if (c == 0xed)
+            hi = 0x9f;
+    }
+    else if (c >= 0xf0 && c <= 0xf4)
+    {
+        len = 4;
+        if (c == 0xf0)
+            lo = 0x90;
+        else if (c == 0xf4)
+            hi = 0x8f;
+    }
+    else
+        return 0;
+    if (n < len)
+        return 0;
+    auto second = static_cast<unsigned char>(s[1]);
+    if (second < lo || second > hi)
+        return 0;
+    for (size_t k = 2; k < len; ++k)
+    {
+        if ((static_cast<unsigned char>(s[k]) & 0xc0) != 0x80)
+            return 0;
+    }
+    return len;
+}
+
+// offset of the first byte of s[0, n) to escape or replace in mode, n if none
+inline size_t sanitize_clean_run(const char* s, size_t n, sanitize_mode mode)
+{
+    size_t i = 0;
+    for (;;)
+    {
+        i += ascii_clean_run(s + i, n - i, mode == sanitize_mode::escape);
+        if (i == n || static_cast<unsigned char>(s[i]) < 0x80)
+            return i;
+        size_t len = utf8_sequence(s + i, n - i);
+        if (!len)
+            return i;
+        i += len;
+    }
+}
+
+inline void sanitize(fmt::MemoryWriter& raw, sanitize_mode mode)
+{
+    static const char hex[] = "0123456789abcdef";
+    static const char replacement[] = "\xef\xbf\xbd";
+    if (mode == sanitize_mode::none)
+        return;
+    size_t clean = sanitize_clean_run(raw.data(), raw.size(), mode);
+    if (clean == raw.size())
+        return;
+
+    // rewrite from the first bad byte on, out of a copy of the rest
+    fmt::MemoryWriter rest;
+    rest.buffer().append(raw.data() + clean, raw.data() + raw.size());
+    auto& out = raw.buffer();
+    out.resize(clean);
+    const char* s = rest.data();
+    size_t n = rest.size();
+    while (n)
+    {
+        auto c = static_cast<unsigned char>(s[0]);
+        if (mode == sanitize_mode::replace)
+            out.append(replacement, replacement + 3);
+        else if (c == '\n')
+            out.append("\\n", "\\n" + 2);
+        else if (c == '\r')
+            out.append("\\r", "\\r" + 2);
+        else if (c == '\t')
+            out.append("\\t", "\\t" + 2);
+        else if (c == '\\')
+            out.append("\\\\", "\\\\" + 2);
+        else
+        {
+            const char escaped[] = { '\\', 'x', hex[c >> 4], hex[c & 0xf] };
+            out.append(escaped, escaped + sizeof(escaped));
+        }
+        clean = sanitize_clean_run(s + 1, n - 1, mode);
+        out.append(s + 1, s + 1 + clean);
+        s += clean + 1;
+        n -= clean + 1;
+    }
+}
+
+}
+}
@@ -0,0 +1,56 @@
+/*************************************************************************/
+/* spdlog - an extremely fast and easy to use c++11 logging library.     */
+/* Copyright (c) 2014 Gabi Melman.                                       */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+#pragma once
+
+
+#include "./shm_ring.h"
+
+//
+// Shared memory logger implementation
+//
+
+inline spdlog::shm_logger::shm_logger(const std::string& logger_name,
+                                      const std::string& shm_name,
+                                      size_t capacity,
+                                      size_t record_size,
+                                      unsigned mode) :
+    logger(logger_name, sinks_init_list()),
+    _ring(new details::shm_ring(shm_name, capacity, record_size, mode))
+{
+}
+
+inline size_t spdlog::shm_logger::dropped() const
+{
+    return _ring->dropped();
+}
+
+inline void spdlog::shm_logger::_log_msg(details::log_msg& msg)
+{
+    _ring->try_enqueue(msg);
+}
+
+inline void spdlog::shm_logger::_flush()
+{
+}
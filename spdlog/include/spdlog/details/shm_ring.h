@@ -0,0 +1,455 @@
+/*************************************************************************/
+/* spdlog - an extremely fast and easy to use c++11 logging library.     */
+/* Copyright (c) 2014 Gabi Melman.                                       */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+// shared memory ring :
+// A bounded queue of fixed size records in POSIX shared memory (shm_open), fed by any number of threads
+// of any number of processes and read by one consumer process (sspdlogd). It is the queue of mpmc_bounded_q
+// laid out in the shared memory: each record has a sequence number telling whose turn it is, so producers
+// only claim a record with a CAS on the enqueue position and never wait. A full ring drops the new message.
+//
+// A record holds a message before formatting: level, time, thread id, logger, file and function names,
+// line and text. What doesn't fit in the record size is cut off (counted in truncated()).
+//
+// Whoever opens the ring first creates and initializes it, with its own capacity and record size, the
+// others attach to it as it is. If a producer dies (or stalls) between claiming a record and publishing it,
+// the consumer gives the record up after stall_timeout so one stuck process can't stop the others' logs;
+// a producer waking up after that may garble the record reusing the slot.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "../common.h"
+#include "./log_msg.h"
+#include "./os.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace spdlog
+{
+namespace details
+{
+
+class shm_ring
+{
+public:
+    // open (creating it if needed) the ring 'name' (like "/sspdlog"), capacity, record_size and the
+    // permission bits mode are only used if it is created here. capacity must be a power of two.
+    shm_ring(const std::string& name, size_t capacity, size_t record_size, unsigned mode = 0600);
+    ~shm_ring();
+
+    shm_ring(shm_ring const&) = delete;
+    shm_ring& operator=(shm_ring const&) = delete;
+
+    // producer side, any thread of any process: copy the message in, false if the ring is full
+    bool try_enqueue(const log_msg& msg);
+
+    // consumer side: take exclusive ownership of the ring (false if another consumer has it),
+    // then pop the oldest message, false if there is none ready
+    bool lock_consumer();
+    bool try_dequeue(log_msg& msg, const std::chrono::milliseconds& stall_timeout = std::chrono::milliseconds(1000));
+    // true if every record claimed so far was dequeued or given up
+    bool empty() const;
+
+    const std::string& name() const;
+    size_t capacity() const;
+    size_t record_size() const;
+    size_t dropped() const;
+    size_t truncated() const;
+    size_t abandoned() const;
+
+    // remove the ring name, the memory goes away once every process closed it
+    static void unlink(const std::string& name);
+
+private:
+    static const uint64_t magic = 0x7373706c6f677231ULL; // "ssplogr1"
+    static const size_t cacheline_size = 64;
+
+    struct header
+    {
+        std::atomic<uint64_t> ready;
+        uint64_t capacity;
+        uint64_t record_size;
+        char pad0[cacheline_size - 3 * sizeof(uint64_t)];
+        std::atomic<uint64_t> enqueue_pos;
+        char pad1[cacheline_size - sizeof(uint64_t)];
+        std::atomic<uint64_t> dequeue_pos;
+        char pad2[cacheline_size - sizeof(uint64_t)];
+        std::atomic<uint64_t> dropped;
+        std::atomic<uint64_t> truncated;
+        std::atomic<uint64_t> abandoned;
+    };
+
+    struct record
+    {
+        std::atomic<uint64_t> sequence;
+        int64_t time;
+        uint64_t thread_id;
+        int32_t level;
+        int32_t line;
+        uint16_t name_size;
+        uint16_t file_size;
+        uint16_t func_size;
+        uint16_t text_size;
+        // followed by the logger name, file name, function name and text
+    };
+
+    static size_t header_size()
+    {
+        return (sizeof(header) + cacheline_size - 1) / cacheline_size * cacheline_size;
+    }
+    record* at(uint64_t pos) const
+    {
+        return reinterpret_cast<record*>(_memory + header_size() + (pos & (_capacity - 1)) * _record_size);
+    }
+
+    std::string _name;
+    int _fd = -1;
+    char* _memory = nullptr;
+    size_t _size = 0;
+    header* _header = nullptr;
+    // checked copies of the header's, which any process mapping the ring could overwrite
+    size_t _capacity = 0;
+    size_t _record_size = 0;
+
+    // consumer only: the claimed but unpublished position it waits for, and since when
+    uint64_t _stalled_pos = ~0ULL;
+    std::chrono::steady_clock::time_point _stalled_since;
+};
+
+}
+}
+
+#ifndef _WIN32
+
+inline spdlog::details::shm_ring::shm_ring(const std::string& name, size_t capacity, size_t record_size, unsigned mode) :
+    _name(name)
+{
+    record_size = (record_size + cacheline_size - 1) / cacheline_size * cacheline_size;
+    if (capacity < 2 || (capacity & (capacity - 1)))
+        throw spdlog_ex("shared memory ring capacity must be a power of two");
+    if (record_size < sizeof(record) + cacheline_size)
+        throw spdlog_ex("shared memory ring record size too small");
+
+    bool creator = true;
+    _fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, static_cast<mode_t>(mode));
+    if (_fd < 0 && errno == EEXIST)
+    {
+        creator = false;
+        _fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    }
+    if (_fd < 0)
+        throw spdlog_ex("Failed opening shared memory " + name);
+
+    if (creator)
+    {
+        _size = header_size() + capacity * record_size;
+        // exactly mode, whatever the umask
+        if (::fchmod(_fd, static_cast<mode_t>(mode)) != 0 || ::ftruncate(_fd, static_cast<off_t>(_size)) != 0)
+        {
+            ::close(_fd);
+            ::shm_unlink(name.c_str());
+            throw spdlog_ex("Failed setting up shared memory " + name);
+        }
+    }
+    else
+    {
+        // the creator sizes the memory right after creating it
+        struct stat st;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (::fstat(_fd, &st) == 0 && st.st_size == 0 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        _size = static_cast<size_t>(st.st_size);
+        if (_size < header_size())
+        {
+            ::close(_fd);
+            throw spdlog_ex("Shared memory " + name + " is not a log ring");
+        }
+    }
+
+    void* memory = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (memory == MAP_FAILED)
+    {
+        ::close(_fd);
+        throw spdlog_ex("Failed mapping shared memory " + name);
+    }
+    _memory = static_cast<char*>(memory);
+    _header = reinterpret_cast<header*>(_memory);
+
+    if (creator)
+    {
+        new (&_header->enqueue_pos) std::atomic<uint64_t>(0);
+        new (&_header->dequeue_pos) std::atomic<uint64_t>(0);
+        new (&_header->dropped) std::atomic<uint64_t>(0);
+        new (&_header->truncated) std::atomic<uint64_t>(0);
+        new (&_header->abandoned) std::atomic<uint64_t>(0);
+        _header->capacity = capacity;
+        _header->record_size = record_size;
+        _capacity = capacity;
+        _record_size = record_size;
+        for (size_t i = 0; i != capacity; ++i)
+            new (&at(i)->sequence) std::atomic<uint64_t>(i);
+        _header->ready.store(magic, std::memory_order_release);
+    }
+    else
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (_header->ready.load(std::memory_order_acquire) != magic && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        _capacity = static_cast<size_t>(_header->capacity);
+        _record_size = static_cast<size_t>(_header->record_size);
+        if (_header->ready.load(std::memory_order_acquire) != magic ||
+                _capacity < 2 || (_capacity & (_capacity - 1)) || _record_size < sizeof(record) + cacheline_size ||
+                _record_size % cacheline_size || _size != header_size() + _capacity * _record_size)
+        {
+            ::munmap(_memory, _size);
+            ::close(_fd);
+            throw spdlog_ex("Shared memory " + name + " is not a log ring");
+        }
+    }
+    if (!_header->enqueue_pos.is_lock_free())
+    {
+        ::munmap(_memory, _size);
+        ::close(_fd);
+        throw spdlog_ex("shared memory ring needs lock free 64 bit atomics");
+    }
+}
+
+inline spdlog::details::shm_ring::~shm_ring()
+{
+    ::munmap(_memory, _size);
+    ::close(_fd);
+}
+
+inline bool spdlog::details::shm_ring::try_enqueue(const log_msg& msg)
+{
+    auto pos = _header->enqueue_pos.load(std::memory_order_relaxed);
+    record* rec;
+    for (;;)
+    {
+        rec = at(pos);
+        auto seq = rec->sequence.load(std::memory_order_acquire);
+        auto dif = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+        if (dif == 0)
+        {
+            if (_header->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0)
+        {
+            _header->dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+            pos = _header->enqueue_pos.load(std::memory_order_relaxed);
+    }
+
+    rec->time = std::chrono::duration_cast<std::chrono::nanoseconds>(msg.time.time_since_epoch()).count();
+    rec->thread_id = msg.thread_id;
+    rec->level = static_cast<int32_t>(msg.level);
+    rec->line = msg.a_msg.line_num;
+
+    // names first, the text gets the rest of the record
+    auto data = reinterpret_cast<char*>(rec + 1);
+    size_t room = _record_size - sizeof(record);
+    auto put = [&data, &room](const char* s, size_t n, uint16_t& size) -> bool
+    {
+        size_t len = n < room ? n : room;
+        if (len > 0xffff)
+            len = 0xffff;
+        std::memcpy(data, s, len);
+        data += len;
+        room -= len;
+        size = static_cast<uint16_t>(len);
+        return len == n;
+    };
+    bool whole = put(msg.logger_name.data(), msg.logger_name.size(), rec->name_size);
+    // only the part #f prints crosses the ring
+    whole = put(msg.a_msg.file_base_name(), msg.a_msg.file_base_size(), rec->file_size) && whole;
+    whole = put(msg.a_msg.func_name.data(), msg.a_msg.func_name.size(), rec->func_size) && whole;
+    whole = put(msg.raw.data(), msg.raw.size(), rec->text_size) && whole;
+    if (!whole)
+        _header->truncated.fetch_add(1, std::memory_order_relaxed);
+
+    // the consumer gave the record up if we took too long, then it is lost
+    auto expected = pos;
+    if (!rec->sequence.compare_exchange_strong(expected, pos + 1, std::memory_order_release, std::memory_order_relaxed))
+    {
+        _header->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+inline bool spdlog::details::shm_ring::lock_consumer()
+{
+    return ::flock(_fd, LOCK_EX | LOCK_NB) == 0;
+}
+
+inline bool spdlog::details::shm_ring::try_dequeue(log_msg& msg, const std::chrono::milliseconds& stall_timeout)
+{
+    for (;;)
+    {
+        auto pos = _header->dequeue_pos.load(std::memory_order_relaxed);
+        auto rec = at(pos);
+        auto seq = rec->sequence.load(std::memory_order_acquire);
+        if (seq != pos + 1)
+        {
+            if (_header->enqueue_pos.load(std::memory_order_relaxed) == pos)
+                return false;
+            // claimed but not published yet
+            auto now = std::chrono::steady_clock::now();
+            if (_stalled_pos != pos)
+            {
+                _stalled_pos = pos;
+                _stalled_since = now;
+            }
+            else if (now - _stalled_since >= stall_timeout &&
+                     rec->sequence.compare_exchange_strong(seq, pos + _capacity, std::memory_order_relaxed))
+            {
+                _header->abandoned.fetch_add(1, std::memory_order_relaxed);
+                _header->dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+            }
+            return false;
+        }
+
+        // sizes garbled (by a late producer or a broken one) would read past the record: give it up
+        size_t name_size = rec->name_size, file_size = rec->file_size, func_size = rec->func_size;
+        size_t text_size = rec->text_size;
+        if (name_size + file_size + func_size + text_size > _record_size - sizeof(record))
+        {
+            _header->abandoned.fetch_add(1, std::memory_order_relaxed);
+            rec->sequence.store(pos + _capacity, std::memory_order_release);
+            _header->dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+            continue;
+        }
+
+        msg.level = rec->level >= 0 && rec->level <= level::off ? static_cast<level::level_enum>(rec->level) : level::info;
+        msg.time = log_clock::time_point(std::chrono::duration_cast<log_clock::duration>(std::chrono::nanoseconds(rec->time)));
+        msg.thread_id = static_cast<size_t>(rec->thread_id);
+        msg.a_msg.line_num = rec->line;
+        auto data = reinterpret_cast<const char*>(rec + 1);
+        msg.logger_name.assign(data, name_size);
+        data += name_size;
+        msg.a_msg.file_name.assign(data, file_size);
+        msg.a_msg.file_base = 0;
+        data += file_size;
+        msg.a_msg.func_name.assign(data, func_size);
+        data += func_size;
+        msg.raw.clear();
+        msg.raw << fmt::BasicStringRef<char>(data, text_size);
+        msg.formatted.clear();
+
+        rec->sequence.store(pos + _capacity, std::memory_order_release);
+        _header->dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+}
+
+inline bool spdlog::details::shm_ring::empty() const
+{
+    return _header->dequeue_pos.load(std::memory_order_relaxed) == _header->enqueue_pos.load(std::memory_order_relaxed);
+}
+
+inline void spdlog::details::shm_ring::unlink(const std::string& name)
+{
+    ::shm_unlink(name.c_str());
+}
+
+#else
+
+inline spdlog::details::shm_ring::shm_ring(const std::string& name, size_t, size_t, unsigned) :
+    _name(name)
+{
+    throw spdlog_ex("shared memory ring is not supported on this platform");
+}
+
+inline spdlog::details::shm_ring::~shm_ring() {}
+
+inline bool spdlog::details::shm_ring::try_enqueue(const log_msg&)
+{
+    return false;
+}
+
+inline bool spdlog::details::shm_ring::lock_consumer()
+{
+    return false;
+}
+
+inline bool spdlog::details::shm_ring::try_dequeue(log_msg&, const std::chrono::milliseconds&)
+{
+    return false;
+}
+
+inline bool spdlog::details::shm_ring::empty() const
+{
+    return true;
+}
+
+inline void spdlog::details::shm_ring::unlink(const std::string&) {}
+
+#endif
+
+inline const std::string& spdlog::details::shm_ring::name() const
+{
+    return _name;
+}
+
+inline size_t spdlog::details::shm_ring::capacity() const
+{
+    return _capacity;
+}
+
+inline size_t spdlog::details::shm_ring::record_size() const
+{
+    return _record_size;
+}
+
+inline size_t spdlog::details::shm_ring::dropped() const
+{
+    return _header ? static_cast<size_t>(_header->dropped.load(std::memory_order_relaxed)) : 0;
+}
+
+inline size_t spdlog::details::shm_ring::truncated() const
+{
+    return _header ? static_cast<size_t>(_header->truncated.load(std::memory_order_relaxed)) : 0;
+}
+
+inline size_t spdlog::details::shm_ring::abandoned() const
+{
+    return _header ? static_cast<size_t>(_header->abandoned.load(std::memory_order_relaxed)) : 0;
+}
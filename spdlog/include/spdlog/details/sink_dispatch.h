@@ -0,0 +1,79 @@
+/*************************************************************************/
+/* spdlog - an extremely fast and easy to use c++11 logging library.     */
+/* Copyright (c) 2014 Gabi Melman.                                       */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+#pragma once
+
+// Writing a message to the sinks of a logger. It comes formatted with the logger's formatter, for the sinks
+// without a formatter of their own. The others are grouped by formatter object: msg is formatted again once
+// per group, in place, and written to the sinks of the group. msg.formatted holds the last format afterwards.
+
+#include <vector>
+
+#include "../common.h"
+#include "../formatter.h"
+#include "../sinks/sink.h"
+#include "./log_msg.h"
+
+namespace spdlog
+{
+namespace details
+{
+
+inline void log_to_sinks(log_msg& msg, const std::vector<sink_ptr>& sinks, const formatter* logger_formatter)
+{
+    bool own_formats = false;
+    for (auto& s : sinks)
+    {
+        auto sink_formatter = s->get_formatter().get();
+        if (!sink_formatter || sink_formatter == logger_formatter)
+            s->log(msg);
+        else
+            own_formats = true;
+    }
+    if (!own_formats)
+        return;
+
+    for (size_t i = 0; i < sinks.size(); ++i)
+    {
+        auto sink_formatter = sinks[i]->get_formatter().get();
+        if (!sink_formatter || sink_formatter == logger_formatter)
+            continue;
+        // first sink of its group
+        bool done = false;
+        for (size_t j = 0; j < i && !done; ++j)
+            done = sinks[j]->get_formatter().get() == sink_formatter;
+        if (done)
+            continue;
+        msg.formatted.clear();
+        sink_formatter->format(msg);
+        for (size_t j = i; j < sinks.size(); ++j)
+        {
+            if (sinks[j]->get_formatter().get() == sink_formatter)
+                sinks[j]->log(msg);
+        }
+    }
+}
+
+}
+}
@@ -28,9 +28,12 @@
 // Global registry functions
 //
 #include "registry.h"
+#include "crash_handler.h"
+#include "fork_handler.h"
 #include "../sinks/file_sinks.h"
 #include "../sinks/stdout_sinks.h"
 #include "../sinks/syslog_sink.h"
+#include "../sinks/shared_writer_sink.h"
 
 inline void spdlog::register_logger(std::shared_ptr<logger> logger)
 {
@@ -42,6 +45,62 @@ inline std::shared_ptr<spdlog::logger> spdlog::get(const std::string& name)
     return details::registry::instance().get(name);
 }
 
+inline void spdlog::apply_all(std::function<void(std::shared_ptr<logger>)> fun)
+{
+    details::registry::instance().apply_all(fun);
+}
+
+inline void spdlog::set_async_memory_budget(size_t bytes)
+{
+    details::async_log_helper::memory_budget().store(bytes);
+}
+
+inline size_t spdlog::async_memory_in_use()
+{
+    return details::async_log_helper::memory_in_use().load(std::memory_order_relaxed);
+}
+
+inline void spdlog::install_crash_handler()
+{
+    details::crash_handler::install();
+}
+
+inline void spdlog::install_fork_handler()
+{
+    details::fork_handler::install();
+}
+
+inline int spdlog::async_poll_fd()
+{
+    return details::async_log_helper::poll_fd();
+}
+
+inline size_t spdlog::drain_async(size_t max_messages, const std::chrono::microseconds& max_time)
+{
+    std::vector<std::shared_ptr<async_logger>> pollers;
+    apply_all([&pollers](std::shared_ptr<logger> l)
+    {
+        auto async_l = std::dynamic_pointer_cast<async_logger>(l);
+        if (async_l && async_l->poll_mode())
+            pollers.push_back(async_l);
+    });
+
+    details::async_log_helper::poll_reset();
+    size_t written = 0;
+    auto start = details::os::now();
+    bool left = false;
+    for (auto &l : pollers)
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(details::os::now() - start);
+        if (written < max_messages && (max_time == std::chrono::microseconds::max() || elapsed < max_time))
+            written += l->drain(max_messages - written, max_time == std::chrono::microseconds::max() ? max_time : max_time - elapsed);
+        left = left || l->pending();
+    }
+    if (left)
+        details::async_log_helper::poll_notify();
+    return written;
+}
+
 inline void spdlog::drop(const std::string &name)
 {
     details::registry::instance().drop(name);
@@ -137,9 +196,9 @@ inline void spdlog::set_level(level::level_enum log_level)
 }
 
 
-inline void spdlog::set_async_mode(size_t queue_size, const async_overflow_policy overflow_policy, const std::function<void()>& worker_warmup_cb, const std::chrono::milliseconds& flush_interval_ms)
+inline void spdlog::set_async_mode(size_t queue_size, const async_overflow_policy overflow_policy, const std::function<void()>& worker_warmup_cb, const std::chrono::milliseconds& flush_interval_ms, const async_options& options)
 {
-    details::registry::instance().set_async_mode(queue_size, overflow_policy, worker_warmup_cb, flush_interval_ms);
+    details::registry::instance().set_async_mode(queue_size, overflow_policy, worker_warmup_cb, flush_interval_ms, options);
 }
 
 inline void spdlog::set_sync_mode()
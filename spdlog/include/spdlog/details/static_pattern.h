@@ -0,0 +1,285 @@
+/*************************************************************************/
+/* spdlog - an extremely fast and easy to use c++11 logging library.     */
+/* Copyright (c) 2014 Gabi Melman.                                       */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+#pragma once
+
+// Pattern parsing for static_pattern_formatter: the pattern is given as a pack of chars (padded with '\0'),
+// static_plan peels it off one char or flag at a time. Fixed text is gathered in a static_text, and runs of
+// date and time fields (with the text between them) in a static_run, rendered once per second like the
+// second runs of pattern_formatter. Fields are written by write_field() with a constant op the compiler folds.
+
+#include "../formatter.h"
+
+#define SPDLOG_STATIC_PATTERN_MAX 128
+
+#define SPDLOG_PATTERN_CHAR(s, i) ::spdlog::details::pattern_char(s, i)
+#define SPDLOG_PATTERN_CHARS_8(s, i) SPDLOG_PATTERN_CHAR(s, i), SPDLOG_PATTERN_CHAR(s, i + 1), \
+    SPDLOG_PATTERN_CHAR(s, i + 2), SPDLOG_PATTERN_CHAR(s, i + 3), SPDLOG_PATTERN_CHAR(s, i + 4), \
+    SPDLOG_PATTERN_CHAR(s, i + 5), SPDLOG_PATTERN_CHAR(s, i + 6), SPDLOG_PATTERN_CHAR(s, i + 7)
+#define SPDLOG_PATTERN_CHARS_64(s, i) SPDLOG_PATTERN_CHARS_8(s, i), SPDLOG_PATTERN_CHARS_8(s, i + 8), \
+    SPDLOG_PATTERN_CHARS_8(s, i + 16), SPDLOG_PATTERN_CHARS_8(s, i + 24), SPDLOG_PATTERN_CHARS_8(s, i + 32), \
+    SPDLOG_PATTERN_CHARS_8(s, i + 40), SPDLOG_PATTERN_CHARS_8(s, i + 48), SPDLOG_PATTERN_CHARS_8(s, i + 56)
+
+namespace spdlog
+{
+namespace details
+{
+
+template<size_t N>
+constexpr char pattern_char(const char (&pattern)[N], size_t i)
+{
+    return i < N ? pattern[i] : '\0';
+}
+
+template<char... Cs>
+struct static_text
+{
+    template<char... More>
+    using append = static_text<Cs..., More...>;
+
+    static const char data[sizeof...(Cs) + 1];
+
+    static void run(log_msg& msg, const zoned_tm&)
+    {
+        details::append(msg.formatted, data, sizeof...(Cs));
+    }
+};
+
+template<char... Cs>
+const char static_text<Cs...>::data[sizeof...(Cs) + 1] = { Cs..., '\0' };
+
+template<>
+struct static_text<>
+{
+    template<char... More>
+    using append = static_text<More...>;
+
+    static void run(log_msg&, const zoned_tm&) {}
+};
+
+enum static_flag_kind { unknown_flag, per_second_flag, other_flag };
+
+// %flag or #flag with its modifiers (see field_spec), Raw is its text in the pattern
+template<char Marker, char Flag, typename Raw, bool Left, unsigned Width, unsigned Max>
+struct static_flag
+{
+    static constexpr pattern_op::code_t code = flag_code(Flag, Marker == '#');
+    static constexpr static_flag_kind kind = code == pattern_op::literal ? unknown_flag :
+                                             pattern_op::per_second_field(code) ? per_second_flag : other_flag;
+
+    static void run(log_msg& msg, const zoned_tm& tm_time)
+    {
+        if (Width || Max)
+            write_field(code, msg, tm_time, Width, Max, Left);
+        else
+            write_field(code, msg, tm_time);
+    }
+};
+
+// the Index-th second run of the pattern, Items are static_text and static_flag
+template<size_t Index, typename... Items>
+struct static_run
+{
+    template<typename... More>
+    using append = static_run<Index, Items..., More...>;
+    typedef static_run<Index + 1> next;
+    static const size_t count = Index + 1;
+
+    static void render(log_msg& msg, const zoned_tm& tm_time)
+    {
+        int items[] = { (Items::run(msg, tm_time), 0)... };
+        (void)items;
+    }
+
+    static void run(log_msg& msg, const zoned_tm& tm_time, second_run* runs)
+    {
+        write_second_run(runs[Index], msg, [&]
+        {
+            render(msg, tm_time);
+        });
+    }
+};
+
+template<size_t Index>
+struct static_run<Index>
+{
+    template<typename... More>
+    using append = static_run<Index, More...>;
+    typedef static_run<Index> next;
+    static const size_t count = Index;
+
+    static void run(log_msg&, const zoned_tm&, second_run*) {}
+};
+
+// the second run and text gathered so far, then the rest of the pattern.
+// second_runs is how many second runs the whole pattern has.
+template<typename Run, typename Text, char... Cs>
+struct static_plan;
+
+template<typename Run, typename Text, typename Flag, static_flag_kind Kind, char... Cs>
+struct static_flag_plan;
+
+// reading the modifiers after a marker, State: 0 at the start, 1 after '-', 2 in the width, 3 in the most
+// bytes (after '.'), 4 after "%<modifiers>#" (modifiers of a new defined flag)
+enum static_spec_kind { spec_end, spec_minus, spec_digit, spec_dot, spec_hash, spec_flag };
+
+constexpr static_spec_kind spec_kind(char marker, int state, char c)
+{
+    return c == '\0' ? spec_end :
+           state == 4 ? spec_flag :
+           c == '-' && state == 0 ? spec_minus :
+           c >= '0' && c <= '9' ? spec_digit :
+           c == '.' && state < 3 ? spec_dot :
+           c == '#' && marker == '%' && state > 0 ? spec_hash : spec_flag;
+}
+
+template<typename Run, typename Text, char Marker, typename Raw, bool Left, unsigned Width, unsigned Max,
+         int State, static_spec_kind Kind, char... Cs>
+struct static_spec_plan;
+
+// end of the pattern
+template<typename Run, typename Text, char... Cs>
+struct static_plan<Run, Text, '\0', Cs...>
+{
+    static const size_t second_runs = Run::count;
+
+    static void run(log_msg& msg, const zoned_tm& tm_time, second_run* runs)
+    {
+        Run::run(msg, tm_time, runs);
+        Text::run(msg, tm_time);
+    }
+};
+
+// fixed text
+template<typename Run, typename Text, char C, char... Cs>
+struct static_plan<Run, Text, C, Cs...> : static_plan<Run, typename Text::template append<C>, Cs...> {};
+
+// %flag, a '%' ending the pattern is dropped
+template<typename Run, typename Text, char F, char... Cs>
+struct static_plan<Run, Text, '%', F, Cs...>
+    : static_spec_plan<Run, Text, '%', static_text<'%'>, false, 0, 0, 0, spec_kind('%', 0, F), F, Cs...> {};
+
+template<typename Run, typename Text, char... Cs>
+struct static_plan<Run, Text, '%', '\0', Cs...> : static_plan<Run, Text, '\0'> {};
+
+// %+ is [%Y-%m-%d %H:%M:%S.%e] [%n] [%l] %v
+#ifndef SPDLOG_NO_DATETIME
+#define SPDLOG_STATIC_FULL_DATETIME '[', '%', 'Y', '-', '%', 'm', '-', '%', 'd', ' ', '%', 'H', ':', '%', 'M', ':', '%', 'S', '.', '%', 'e', ']', ' ',
+#else
+#define SPDLOG_STATIC_FULL_DATETIME
+#endif
+#ifndef SPDLOG_NO_NAME
+#define SPDLOG_STATIC_FULL_NAME '[', '%', 'n', ']', ' ',
+#else
+#define SPDLOG_STATIC_FULL_NAME
+#endif
+
+template<typename Run, typename Text, char... Cs>
+struct static_plan<Run, Text, '%', '+', Cs...>
+    : static_plan<Run, Text, SPDLOG_STATIC_FULL_DATETIME SPDLOG_STATIC_FULL_NAME '[', '%', 'l', ']', ' ', '%', 'v', Cs...> {};
+
+#undef SPDLOG_STATIC_FULL_DATETIME
+#undef SPDLOG_STATIC_FULL_NAME
+
+// #flag, "##" is a '#' then what follows, a '#' ending the pattern is kept
+template<typename Run, typename Text, char F, char... Cs>
+struct static_plan<Run, Text, '#', F, Cs...>
+    : static_spec_plan<Run, Text, '#', static_text<'#'>, false, 0, 0, 0, spec_kind('#', 0, F), F, Cs...> {};
+
+template<typename Run, typename Text, char... Cs>
+struct static_plan<Run, Text, '#', '#', Cs...> : static_plan<Run, typename Text::template append<'#'>, '#', Cs...> {};
+
+template<typename Run, typename Text, char... Cs>
+struct static_plan<Run, Text, '#', '\0', Cs...> : static_plan<Run, typename Text::template append<'#'>, '\0'> {};
+
+// modifiers
+template<typename Run, typename Text, char Marker, char... Rs, bool Left, unsigned Width, unsigned Max, int State,
+         char C, char N, char... Cs>
+struct static_spec_plan<Run, Text, Marker, static_text<Rs...>, Left, Width, Max, State, spec_minus, C, N, Cs...>
+    : static_spec_plan<Run, Text, Marker, static_text<Rs..., C>, true, Width, Max, 1, spec_kind(Marker, 1, N), N, Cs...> {};
+
+template<typename Run, typename Text, char Marker, char... Rs, bool Left, unsigned Width, unsigned Max, int State,
+         char C, char N, char... Cs>
+struct static_spec_plan<Run, Text, Marker, static_text<Rs...>, Left, Width, Max, State, spec_digit, C, N, Cs...>
+    : static_spec_plan<Run, Text, Marker, static_text<Rs..., C>, Left,
+                       State < 3 ? Width * 10 + static_cast<unsigned>(C - '0') : Width,
+                       State == 3 ? Max * 10 + static_cast<unsigned>(C - '0') : Max,
+                       State < 3 ? 2 : 3, spec_kind(Marker, State < 3 ? 2 : 3, N), N, Cs...> {};
+
+template<typename Run, typename Text, char Marker, char... Rs, bool Left, unsigned Width, unsigned Max, int State,
+         char C, char N, char... Cs>
+struct static_spec_plan<Run, Text, Marker, static_text<Rs...>, Left, Width, Max, State, spec_dot, C, N, Cs...>
+    : static_spec_plan<Run, Text, Marker, static_text<Rs..., C>, Left, Width, Max, 3, spec_kind(Marker, 3, N), N, Cs...> {};
+
+template<typename Run, typename Text, char Marker, char... Rs, bool Left, unsigned Width, unsigned Max, int State,
+         char C, char N, char... Cs>
+struct static_spec_plan<Run, Text, Marker, static_text<Rs...>, Left, Width, Max, State, spec_hash, C, N, Cs...>
+    : static_spec_plan<Run, Text, '#', static_text<Rs..., C>, Left, Width, Max, 4, spec_kind('#', 4, N), N, Cs...> {};
+
+// the pattern ending in the modifiers, they are written as is
+template<typename Run, typename Text, char Marker, char... Rs, bool Left, unsigned Width, unsigned Max, int State,
+         char... Cs>
+struct static_spec_plan<Run, Text, Marker, static_text<Rs...>, Left, Width, Max, State, spec_end, '\0', Cs...>
+    : static_plan<Run, typename Text::template append<Rs...>, '\0'> {};
+
+// the flag
+template<typename Run, typename Text, char Marker, char... Rs, bool Left, unsigned Width, unsigned Max, int State,
+         char F, char... Cs>
+struct static_spec_plan<Run, Text, Marker, static_text<Rs...>, Left, Width, Max, State, spec_flag, F, Cs...>
+    : static_flag_plan<Run, Text, static_flag<Marker, F, static_text<Rs..., F>, Left, Width, Max>,
+                       static_flag<Marker, F, static_text<Rs..., F>, Left, Width, Max>::kind, Cs...> {};
+
+// %+ with modifiers, they are ignored
+template<typename Run, typename Text, char... Rs, bool Left, unsigned Width, unsigned Max, int State, char... Cs>
+struct static_spec_plan<Run, Text, '%', static_text<Rs...>, Left, Width, Max, State, spec_flag, '+', Cs...>
+    : static_plan<Run, Text, '%', '+', Cs...> {};
+
+// an unknown flag is written as is
+template<typename Run, char... Ls, char Marker, char F, char... Rs, bool Left, unsigned Width, unsigned Max, char... Cs>
+struct static_flag_plan<Run, static_text<Ls...>, static_flag<Marker, F, static_text<Rs...>, Left, Width, Max>, unknown_flag, Cs...>
+    : static_plan<Run, static_text<Ls..., Rs...>, Cs...> {};
+
+// a date or time field joins the second run, with the text before it
+template<typename Run, typename Text, typename Flag, char... Cs>
+struct static_flag_plan<Run, Text, Flag, per_second_flag, Cs...>
+    : static_plan<typename Run::template append<Text, Flag>, static_text<>, Cs...> {};
+
+// any other field ends the second run
+template<typename Run, typename Text, typename Flag, char... Cs>
+struct static_flag_plan<Run, Text, Flag, other_flag, Cs...>
+{
+    typedef static_plan<typename Run::next, static_text<>, Cs...> next;
+    static const size_t second_runs = next::second_runs;
+
+    static void run(log_msg& msg, const zoned_tm& tm_time, second_run* runs)
+    {
+        Run::run(msg, tm_time, runs);
+        Text::run(msg, tm_time);
+        Flag::run(msg, tm_time);
+        next::run(msg, tm_time, runs);
+    }
+};
+
+}
+}
@@ -23,13 +23,13 @@
 /*************************************************************************/
 #pragma once
 
+#include <atomic>
+#include <ctime>
+#include <memory>
 #include "details/log_msg.h"
+#include "details/pattern_plan.h"
 namespace spdlog
 {
-namespace details
-{
-class flag_formatter;
-}
 
 class formatter
 {
@@ -42,16 +42,28 @@ class pattern_formatter : public formatter
 {
 
 public:
-    explicit pattern_formatter(const std::string& pattern);
+    explicit pattern_formatter(const std::string& pattern, const time_zone& tz = time_zone());
     pattern_formatter(const pattern_formatter&) = delete;
     pattern_formatter& operator=(const pattern_formatter&) = delete;
     void format(details::log_msg& msg) override;
 private:
     const std::string _pattern;
-    std::vector<std::unique_ptr<details::flag_formatter>> _formatters;
-    void handle_flag(char flag);
-    void handle_new_defined_flag(char flag);
+    std::vector<details::pattern_op> _ops;
+    std::string _literals;
+    std::vector<std::unique_ptr<details::second_run>> _runs;
+    // bytes to reserve per message besides the message fields, and how many times each of these is written
+    size_t _reserve = 0;
+    size_t _name_ops = 0, _text_ops = 0, _file_ops = 0, _func_ops = 0;
+
+    details::tm_cache _time;
+
+    bool handle_flag(char flag, const details::field_spec& spec);
+    bool handle_new_defined_flag(char flag, const details::field_spec& spec);
+    void add_op(details::pattern_op::code_t code, const details::field_spec& spec = details::field_spec());
+    void add_literal(const char* s, size_t n);
     void compile_pattern(const std::string& pattern);
+    void group_second_runs();
+    void run(const std::vector<details::pattern_op>& ops, details::log_msg& msg, const details::zoned_tm& tm_time);
 };
 }
 
@@ -0,0 +1,55 @@
+/*************************************************************************/
+/* spdlog - an extremely fast and easy to use c++11 logging library.     */
+/* Copyright (c) 2014 Gabi Melman.                                       */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+#pragma once
+
+// Formatter writing each message as one JSON object per line:
+//
+// {"time":"2017-01-10T04:33:20.007+08:00","level":"WARNING","logger":"root_logger","thread":42,"file":"main.cpp","line":12,"func":"run","msg":"text"}
+//
+// file, line and func are left out for messages logged without a source location. Strings are escaped
+// as JSON requires (quote, backslash and control characters), valid UTF-8 is copied as it is, and each
+// byte of invalid UTF-8 is written as \ufffd.
+
+#include "formatter.h"
+
+namespace spdlog
+{
+
+class json_formatter : public formatter
+{
+public:
+    explicit json_formatter(const time_zone& tz = time_zone());
+    json_formatter(const json_formatter&) = delete;
+    json_formatter& operator=(const json_formatter&) = delete;
+    void format(details::log_msg& msg) override;
+
+private:
+    details::second_run _time_prefix;   // {"time":"2017-01-10T04:33:20
+    details::tm_cache _time;
+};
+
+}
+
+#include "details/json_formatter_impl.h"
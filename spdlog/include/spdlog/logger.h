@@ -59,8 +59,13 @@ public:
     void set_level(level::level_enum);
     level::level_enum level() const;
 
+    // escape or replace control bytes and invalid UTF-8 in the text of the messages, none by default
+    void set_sanitize(sanitize_mode);
+    sanitize_mode sanitize() const;
+
     const std::string& name() const;
     bool should_log(level::level_enum) const;
+    const std::vector<sink_ptr>& sinks() const;
 
     // logger.info(cppformat_string, arg1, arg2, arg3, ...) call style
     template <typename... Args> details::line_logger trace(const details::add_msg &a_msg, const char* fmt, const Args&... args);
@@ -109,8 +114,14 @@ public:
 
     void flush();
 
+    // Log a message built elsewhere (e.g. received from another process) as is: its time, thread id
+    // and logger name are kept, and it is logged whatever the logger's level
+    void replay(details::log_msg& msg);
+
 protected:
     virtual void _log_msg(details::log_msg&);
+    void _sanitize_msg(details::log_msg&);
+    virtual void _flush();
     virtual void _set_pattern(const std::string&);
     virtual void _set_formatter(formatter_ptr);
     details::line_logger _log_if_enabled(level::level_enum lvl, const details::add_msg &a_msg);
@@ -125,6 +136,7 @@ protected:
     std::vector<sink_ptr> _sinks;
     formatter_ptr _formatter;
     std::atomic_int _level;
+    std::atomic_int _sanitize;
 
 };
 }
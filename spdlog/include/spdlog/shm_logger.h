@@ -0,0 +1,69 @@
+/*************************************************************************/
+/* spdlog - an extremely fast and easy to use c++11 logging library.     */
+/* Copyright (c) 2014 Gabi Melman.                                       */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+#pragma once
+
+// Logger writing its messages, before formatting, to a shared memory ring (details/shm_ring.h)
+// read by another process, the sspdlogd daemon, which formats and writes them through its own sinks.
+// Logging never blocks: a message finding the ring full is dropped and counted.
+// The logger has no sinks of its own, its pattern is the daemon's one and flush() does nothing.
+
+#include <memory>
+#include "common.h"
+#include "logger.h"
+
+
+namespace spdlog
+{
+
+namespace details
+{
+class shm_ring;
+}
+
+class shm_logger :public logger
+{
+public:
+    // open (or create) the ring 'shm_name', capacity, record_size and mode (its permission bits) are used
+    // only if it is created here
+    shm_logger(const std::string& logger_name,
+               const std::string& shm_name,
+               size_t capacity = 65536,
+               size_t record_size = 512,
+               unsigned mode = 0600);
+
+    // number of messages the ring had no room for, from all its processes
+    size_t dropped() const;
+
+protected:
+    void _log_msg(details::log_msg& msg) override;
+    void _flush() override;
+
+private:
+    std::unique_ptr<details::shm_ring> _ring;
+};
+}
+
+
+#include "./details/shm_logger_impl.h"
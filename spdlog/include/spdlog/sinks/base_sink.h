@@ -58,6 +58,18 @@ public:
         _sink_it(msg);
     }
 
+    void prepare_fork() override
+    {
+        _mutex.lock();
+        flush();
+    }
+
+    void after_fork(bool child) override
+    {
+        (void)child;
+        _mutex.unlock();
+    }
+
 protected:
     virtual void _sink_it(const details::log_msg& msg) = 0;
     Mutex _mutex;
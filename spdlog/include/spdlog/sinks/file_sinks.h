@@ -57,6 +57,7 @@ class simple_file_sink : public base_sink < Mutex >
 public:
     explicit simple_file_sink(const std::string &filename,
                               bool force_flush = false) :
+        _filename(filename),
         _file_helper(force_flush)
     {
         _file_helper.open(filename);
@@ -66,12 +67,33 @@ public:
         _file_helper.flush();
     }
 
+    void crash_write(const char* data, size_t size) override
+    {
+        _file_helper.crash_write(data, size);
+    }
+
+    // after fork(), the child writes to "filename.PID" instead
+    void set_child_pid_suffix(bool enabled)
+    {
+        _child_pid_suffix = enabled;
+    }
+
+    void after_fork(bool child) override
+    {
+        // the child has no other thread yet
+        base_sink<Mutex>::after_fork(child);
+        if (child && _child_pid_suffix)
+            _file_helper.open(_filename + "." + std::to_string(details::os::pid()));
+    }
+
 protected:
     void _sink_it(const details::log_msg& msg) override
     {
         _file_helper.write(msg);
     }
 private:
+    std::string _filename;
+    bool _child_pid_suffix = false;
     details::file_helper _file_helper;
 };
 
@@ -93,7 +115,8 @@ public:
         _max_size(max_size),
         _max_files(max_files),
         _current_size(0),
-        _file_helper(force_flush)
+        _file_helper(force_flush),
+        _parent_filename(base_filename)
     {
         _file_helper.open(calc_filename(_base_filename, 0, _extension));
     }
@@ -103,6 +126,29 @@ public:
         _file_helper.flush();
     }
 
+    void crash_write(const char* data, size_t size) override
+    {
+        _file_helper.crash_write(data, size);
+    }
+
+    // after fork(), the child writes to (and rotates) "base_filename.PID.extension" instead
+    void set_child_pid_suffix(bool enabled)
+    {
+        _child_pid_suffix = enabled;
+    }
+
+    void after_fork(bool child) override
+    {
+        // the child has no other thread yet
+        base_sink<Mutex>::after_fork(child);
+        if (child && _child_pid_suffix)
+        {
+            _base_filename = _parent_filename + "." + std::to_string(details::os::pid());
+            _file_helper.open(calc_filename(_base_filename, 0, _extension));
+            _current_size = 0;
+        }
+    }
+
 protected:
     void _sink_it(const details::log_msg& msg) override
     {
@@ -160,6 +206,8 @@ private:
     std::size_t _max_files;
     std::size_t _current_size;
     details::file_helper _file_helper;
+    std::string _parent_filename;
+    bool _child_pid_suffix = false;
 };
 
 typedef rotating_file_sink<std::mutex> rotating_file_sink_mt;
@@ -184,7 +232,8 @@ public:
         _rotation_h(rotation_hour),
         _rotation_m(rotation_minute),
         _max_files(max_files),
-        _file_helper(force_flush)
+        _file_helper(force_flush),
+        _parent_filename(base_filename)
     {
         if (rotation_hour < 0 || rotation_hour > 23 || rotation_minute < 0 || rotation_minute > 59)
             throw spdlog_ex("daily_file_sink: Invalid rotation time in ctor");
@@ -209,6 +258,28 @@ public:
         _file_helper.flush();
     }
 
+    void crash_write(const char* data, size_t size) override
+    {
+        _file_helper.crash_write(data, size);
+    }
+
+    // after fork(), the child writes to (and rotates) "base_filename.PID.extension" instead
+    void set_child_pid_suffix(bool enabled)
+    {
+        _child_pid_suffix = enabled;
+    }
+
+    void after_fork(bool child) override
+    {
+        // the child has no other thread yet
+        base_sink<Mutex>::after_fork(child);
+        if (child && _child_pid_suffix)
+        {
+            _base_filename = _parent_filename + "." + std::to_string(details::os::pid());
+            _file_helper.open(calc_filename(_base_filename, 0, _extension));
+        }
+    }
+
 protected:
     void _sink_it(const details::log_msg& msg) override
     {
@@ -333,6 +404,8 @@ private:
     std::size_t _max_files;
     std::chrono::system_clock::time_point _rotation_tp;
     details::file_helper _file_helper;
+    std::string _parent_filename;
+    bool _child_pid_suffix = false;
 };
 
 typedef daily_file_sink<std::mutex> daily_file_sink_mt;
@@ -0,0 +1,266 @@
+/*************************************************************************/
+/* spdlog - an extremely fast and easy to use c++11 logging library.     */
+/* Copyright (c) 2014 Gabi Melman.                                       */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+// Sink shared by several loggers, usually async ones: their workers hand the formatted messages over to a
+// single writer thread, which writes them to the wrapped sink in time order instead of interleaving the
+// workers' writes. The wrapped sink can be an _st one only if nothing else writes it: sync loggers, and the
+// crash and fork handlers, still write it directly.
+//
+// Each logger hands its messages in time order, the writer holds them back for merge_window so the other
+// loggers can catch up, and writes the merged stream. A message later than that is written as it comes.
+// flush() writes everything handed over so far, whatever its age, and flushes the wrapped sink.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./sink.h"
+#include "../common.h"
+#include "../details/log_msg.h"
+
+namespace spdlog
+{
+namespace sinks
+{
+class shared_writer_sink : public sink
+{
+public:
+    explicit shared_writer_sink(sink_ptr sink,
+                                std::chrono::milliseconds merge_window = std::chrono::milliseconds(10),
+                                size_t max_pending = 8192) :
+        _sink(std::move(sink)),
+        _merge_window(merge_window),
+        _max_pending(max_pending),
+        _flush_requested(0),
+        _flushed(0),
+        _stop(false)
+    {
+        if (!_sink)
+            throw spdlog_ex("shared writer needs a sink");
+        if (!_max_pending)
+            throw spdlog_ex("shared writer needs room for at least one message");
+        _thread = std::thread(&shared_writer_sink::writer_loop, this);
+    }
+
+    shared_writer_sink(const shared_writer_sink&) = delete;
+    shared_writer_sink& operator=(const shared_writer_sink&) = delete;
+
+    // write what is left, nobody else holds the sink any more
+    ~shared_writer_sink()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_one();
+        _thread.join();
+    }
+
+    void log(const details::log_msg& msg) override
+    {
+        details::log_msg copy(msg);
+        std::unique_lock<std::mutex> lock(_mutex);
+        throw_if_bad_writer();
+        _not_full.wait(lock, [this]() { return _incoming.size() < _max_pending; });
+        _incoming.push_back(std::move(copy));
+        if (_incoming.size() == 1)
+            _wake.notify_one();
+    }
+
+    void flush() override
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto ticket = ++_flush_requested;
+        _wake.notify_one();
+        _done.wait(lock, [this, ticket]() { return _flushed >= ticket; });
+        throw_if_bad_writer();
+    }
+
+    // the messages still held by the writer are lost, the wrapped sink gets what the async loggers had queued
+    void crash_write(const char* data, size_t size) override
+    {
+        _sink->crash_write(data, size);
+    }
+
+    const sink_ptr& wrapped() const
+    {
+        return _sink;
+    }
+
+    // the loggers format the messages for the wrapped sink before handing them over
+    void set_formatter(formatter_ptr msg_formatter) override
+    {
+        _sink->set_formatter(std::move(msg_formatter));
+    }
+
+    const formatter_ptr& get_formatter() const override
+    {
+        return _sink->get_formatter();
+    }
+
+    // stop the writer once it wrote and flushed everything, so the wrapped sink can be prepared after us
+    void prepare_fork() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_one();
+        _thread.join();
+        _mutex.lock();
+    }
+
+    void after_fork(bool child) override
+    {
+        if (child)
+        {
+            // handed over by the parent's other threads, and nobody waits here
+            _incoming.clear();
+            _flushed = _flush_requested;
+            new (&_not_full) std::condition_variable();
+            new (&_done) std::condition_variable();
+        }
+        _stop = false;
+        _thread = std::thread(&shared_writer_sink::writer_loop, this);
+        _mutex.unlock();
+        _not_full.notify_all();
+    }
+
+private:
+    static bool earlier(const details::log_msg& a, const details::log_msg& b)
+    {
+        return a.time < b.time;
+    }
+
+    void throw_if_bad_writer()
+    {
+        if (!_error.empty())
+        {
+            auto what = std::move(_error);
+            _error.clear();
+            throw spdlog_ex("shared writer exception: " + what);
+        }
+    }
+
+    void write(const details::log_msg& msg)
+    {
+        try
+        {
+            _sink->log(msg);
+        }
+        catch (const std::exception& ex)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _error = ex.what();
+        }
+    }
+
+    void writer_loop()
+    {
+        std::vector<details::log_msg> batch;
+        std::deque<details::log_msg> pending;
+        size_t flushed;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            flushed = _flushed;
+        }
+        bool stop = false;
+        while (!stop)
+        {
+            size_t flush_to;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                auto ready = [this, flushed]() { return !_incoming.empty() || _stop || _flush_requested != flushed; };
+                if (pending.empty())
+                    _wake.wait(lock, ready);
+                else
+                    _wake.wait_until(lock, pending.front().time + _merge_window, ready);
+                if (_incoming.size() >= _max_pending)
+                    _not_full.notify_all();
+                batch.swap(_incoming);
+                flush_to = _flush_requested;
+                stop = _stop;
+            }
+
+            if (!batch.empty())
+            {
+                // a stable sort keeps the arrival order of equal times, so each logger's order
+                std::stable_sort(batch.begin(), batch.end(), earlier);
+                auto merged = pending.size();
+                std::move(batch.begin(), batch.end(), std::back_inserter(pending));
+                std::inplace_merge(pending.begin(), pending.begin() + merged, pending.end(), earlier);
+                batch.clear();
+            }
+
+            auto horizon = log_clock::now() - _merge_window;
+            bool all = stop || flush_to != flushed;
+            while (!pending.empty() && (all || pending.front().time <= horizon))
+            {
+                write(pending.front());
+                pending.pop_front();
+            }
+
+            if (flush_to != flushed || stop)
+            {
+                try
+                {
+                    _sink->flush();
+                }
+                catch (const std::exception& ex)
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _error = ex.what();
+                }
+                flushed = flush_to;
+                std::lock_guard<std::mutex> lock(_mutex);
+                _flushed = flushed;
+                _done.notify_all();
+            }
+        }
+    }
+
+    sink_ptr _sink;
+    std::chrono::milliseconds _merge_window;
+    size_t _max_pending;
+
+    std::mutex _mutex;
+    std::condition_variable _wake, _not_full, _done;
+    std::vector<details::log_msg> _incoming;
+    size_t _flush_requested;
+    size_t _flushed;
+    bool _stop;
+    std::string _error;
+    std::thread _thread;
+};
+}
+}
@@ -24,6 +24,7 @@
 
 #pragma once
 
+#include "../common.h"
 #include "../details/log_msg.h"
 
 namespace spdlog
@@ -36,6 +37,42 @@ public:
     virtual ~sink() {}
     virtual void log(const details::log_msg& msg) = 0;
     virtual void flush() = 0;
+
+    // Formatter of this sink's lines instead of the logger's one (null: the logger's), set before logging.
+    // Sinks given the same formatter object get the message formatted once for all of them (see details/sink_dispatch.h).
+    virtual void set_formatter(formatter_ptr msg_formatter)
+    {
+        _formatter = std::move(msg_formatter);
+    }
+
+    virtual const formatter_ptr& get_formatter() const
+    {
+        return _formatter;
+    }
+
+    // Called from a fatal signal handler to write already formatted bytes (see details/crash_handler.h).
+    // Must not lock, allocate or throw. Sinks which can't do that ignore the data.
+    virtual void crash_write(const char* data, size_t size)
+    {
+        (void)data;
+        (void)size;
+    }
+
+    // Called around fork() by the fork handler (see details/fork_handler.h), with the async back threads parked:
+    // prepare_fork() before it, after_fork() in both processes. Sinks write out what they buffered and keep
+    // their lock until after_fork(), so a child neither inherits a held lock nor writes the parent's lines again.
+    virtual void prepare_fork()
+    {
+        flush();
+    }
+
+    virtual void after_fork(bool child)
+    {
+        (void)child;
+    }
+
+private:
+    formatter_ptr _formatter;
 };
 }
 }
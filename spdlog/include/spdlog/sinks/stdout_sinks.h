@@ -28,6 +28,7 @@
 #include <mutex>
 #include "./ostream_sink.h"
 #include "../details/null_mutex.h"
+#include "../details/os.h"
 #include <string>
 
 namespace spdlog
@@ -41,6 +42,10 @@ class stdout_sink : public ostream_sink<Mutex>
     using MyType = stdout_sink<Mutex>;
 public:
     stdout_sink() : ostream_sink<Mutex>(std::cout, true) {}
+    void crash_write(const char* data, size_t size) override
+    {
+        details::os::crash_write(1, data, size);
+    }
     static std::shared_ptr<MyType> instance()
     {
         static std::shared_ptr<MyType> instance = std::make_shared<MyType>();
@@ -81,6 +86,10 @@ class stderr_sink : public ostream_sink<Mutex>
     using MyType = stderr_sink<Mutex>;
 public:
     stderr_sink() : ostream_sink<Mutex>(std::cerr, true) {}
+    void crash_write(const char* data, size_t size) override
+    {
+        details::os::crash_write(2, data, size);
+    }
     static std::shared_ptr<MyType> instance()
     {
         static std::shared_ptr<MyType> instance = std::make_shared<MyType>();
@@ -28,9 +28,13 @@
 
 #pragma once
 
+#include <functional>
+#include <limits>
 #include "tweakme.h"
 #include "common.h"
 #include "logger.h"
+#include "static_formatter.h"
+#include "json_formatter.h"
 
 namespace spdlog
 {
@@ -64,15 +68,53 @@ void set_level(level::level_enum log_level);
 // async_overflow_policy (optional, block_retry by default):
 //    async_overflow_policy::block_retry - if queue is full, block until queue has room for the new log entry.
 //    async_overflow_policy::discard_log_msg - never block and discard any new messages when queue  overflows.
+//    async_overflow_policy::overwrite_oldest - never block and discard the oldest queued message to make room.
+//    async_overflow_policy::block_timeout - block up to options.block_timeout, then discard the new message.
+//    async_overflow_policy::discard_below_level - discard new messages below options.discard_level, block for the others.
+//    Discarded messages are counted per level, and reported every options.drop_report_interval by a warning line.
+//    options.priority_level (level::off by default) opts in to a second queue for messages of that level or above,
+//    drained first and never discarded.
 //
 // worker_warmup_cb (optional):
 //     callback function that will be called in worker thread upon start (can be used to init stuff like thread affinity)
 //
-void set_async_mode(size_t queue_size, const async_overflow_policy overflow_policy = async_overflow_policy::block_retry, const std::function<void()>& worker_warmup_cb = nullptr, const std::chrono::milliseconds& flush_interval_ms = std::chrono::milliseconds::zero());
+void set_async_mode(size_t queue_size, const async_overflow_policy overflow_policy = async_overflow_policy::block_retry, const std::function<void()>& worker_warmup_cb = nullptr, const std::chrono::milliseconds& flush_interval_ms = std::chrono::milliseconds::zero(), const async_options& options = async_options());
 
 // Turn off async mode
 void set_sync_mode();
 
+//
+// Limit the bytes of message data (texts, logger, file and function names) queued in all async loggers
+// together, 0 (the default) for no limit. A message which would exceed it is handled by the logger's
+// overflow policy as if the queue was full. async_memory_in_use() returns the bytes queued now.
+//
+void set_async_memory_budget(size_t bytes);
+size_t async_memory_in_use();
+
+//
+// Install handlers for SIGSEGV, SIGABRT, SIGBUS, SIGFPE and std::terminate (opt-in, installed once).
+// On a crash they stop logging, write the messages still queued in the async loggers directly
+// to their file and console sinks, then re-raise the signal to the previous handler.
+//
+void install_crash_handler();
+
+//
+// Make fork() safe after logging (pthread_atfork, opt-in, installed once): before it, the async loggers'
+// threads are parked and the sinks flushed and locked, then the parent goes on, while the child drops
+// what the parent's threads had queued and gets its own threads. File sinks set with
+// set_child_pid_suffix(true) write to a file named after the child's pid in the child.
+//
+void install_fork_handler();
+
+//
+// Poll mode async loggers (async_options::poll_mode) have no worker thread. Register async_poll_fd()
+// (an eventfd, -1 where not supported) in the application's event loop: it gets readable when messages
+// are queued, then drain_async() writes up to max_messages of them, for at most about max_time, in the
+// calling thread. It returns the messages written, and signals the fd again if some are left.
+//
+int async_poll_fd();
+size_t drain_async(size_t max_messages = std::numeric_limits<size_t>::max(), const std::chrono::microseconds& max_time = std::chrono::microseconds::max());
+
 //
 // Create and register multi/single threaded rotating file logger
 //
@@ -118,6 +160,11 @@ std::shared_ptr<spdlog::logger> create(const std::string& logger_name, const Arg
 // Register the given logger with the given name
 void register_logger(std::shared_ptr<logger> logger);
 
+// Apply a user defined function on all registered loggers
+// Example:
+// spdlog::apply_all([&](std::shared_ptr<spdlog::logger> l) {l->flush();});
+void apply_all(std::function<void(std::shared_ptr<logger>)> fun);
+
 // Drop the reference to the given logger
 void drop(const std::string &name);
 
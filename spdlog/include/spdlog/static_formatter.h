@@ -0,0 +1,72 @@
+/*************************************************************************/
+/* spdlog - an extremely fast and easy to use c++11 logging library.     */
+/* Copyright (c) 2014 Gabi Melman.                                       */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+#pragma once
+
+// Formatter for a pattern known at build time, parsed by the compiler:
+//
+//     logger->set_formatter(std::make_shared<SPDLOG_STATIC_PATTERN("[%H:%M:%S.%e] [%l] %v")>());
+//
+// It writes the same lines as pattern_formatter with the same pattern, but each flag is a direct call
+// with no op dispatch, the fixed text between flags is one append, and the date and time runs are
+// cached per second the same way. Patterns are at most
+// SPDLOG_STATIC_PATTERN_MAX (128) characters.
+
+#include <ctime>
+#include "formatter.h"
+#include "details/static_pattern.h"
+
+namespace spdlog
+{
+
+template<size_t Length, char... Cs>
+class static_pattern_formatter : public formatter
+{
+    static_assert(Length <= SPDLOG_STATIC_PATTERN_MAX, "static pattern longer than SPDLOG_STATIC_PATTERN_MAX");
+
+public:
+    explicit static_pattern_formatter(const time_zone& tz = time_zone()) : _time(tz) {}
+
+    void format(details::log_msg& msg) override
+    {
+        auto tm_time = _time.get(log_clock::to_time_t(msg.time));
+        // room for the whole line at once, allowing for the longest date fields
+        msg.formatted.buffer().reserve(msg.formatted.size() + 2 * Length + 32 + details::os::eol_size() +
+                                       msg.logger_name.size() + msg.raw.size() +
+                                       msg.a_msg.file_name.size() + msg.a_msg.func_name.size());
+        plan::run(msg, tm_time, _runs);
+        details::append(msg.formatted, details::os::eol(), details::os::eol_size());
+    }
+
+private:
+    typedef details::static_plan<details::static_run<0>, details::static_text<>, Cs...> plan;
+
+    details::second_run _runs[plan::second_runs ? plan::second_runs : 1];
+    details::tm_cache _time;
+};
+
+}
+
+#define SPDLOG_STATIC_PATTERN(pattern) ::spdlog::static_pattern_formatter<sizeof(pattern) - 1, \
+    SPDLOG_PATTERN_CHARS_64(pattern, 0), SPDLOG_PATTERN_CHARS_64(pattern, 64), '\0'>
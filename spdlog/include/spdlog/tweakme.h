@@ -72,3 +72,10 @@
 // Note that upon creating a logger the registry is modified by spdlog..
 // #define SPDLOG_NO_REGISTRY_MUTEX
 ///////////////////////////////////////////////////////////////////////////////
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment (or pass with -D) to have #f print the source path relative to this prefix
+// instead of the base name, for the files under it. Resolved at compile time.
+// #define SPDLOG_FILE_PREFIX "/home/me/project/"
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,137 @@
+//
+// sspdlogd: the logging daemon of the "*_daemon = 1" loggers
+//      1) reads the same config file as the applications (sspdlog.conf, or the one given as argument)
+//      2) creates the loggers and their sinks from it, as an application would (but none of them is a daemon logger)
+//      3) reads what every process on the host logged into the shared memory ring "daemon_shm_name",
+//         formats it with the pattern of the logger of the same name (root_logger if unknown) and writes it
+//      4) on SIGINT or SIGTERM, writes what is left in the ring and exits
+//
+// Only one daemon reads a ring. The ring outlives it, a restarted daemon goes on where the last one stopped.
+//
+
+#include <csignal>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <sspdlog/sspdlog.h>
+
+namespace
+{
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void on_stop(int)
+{
+    stop_requested = 1;
+}
+
+class SspdlogDaemon : public sspdlog::Sspdlogger
+{
+public:
+    SspdlogDaemon(const std::shared_ptr< sspdlog::SspdlogConfig > &conf) : Sspdlogger(conf) {}
+};
+
+}
+
+int main(int argc, char *argv[])
+{
+    std::string filename = argc > 1 ? argv[1] : sspdlog::DEFAULT_CONF_FILE;
+    auto conf = std::make_shared< sspdlog::SspdlogConfig >();
+    if (!conf->ReadConfigFromSimpleFile(filename))
+        std::cerr << "sspdlogd: can't read " << filename << ", using the default config" << std::endl;
+
+    // the daemon's loggers write to their sinks themselves
+    std::map< std::string, std::string > local_loggers = { { std::string(sspdlog::DEFAULT_LOGGER_NAME) + "_daemon", "0" } };
+    auto names = conf->GetCurrentConfig(sspdlog::LOGGER_NAMES_KEY);
+    std::string::size_type cur_p = 0;
+    while (cur_p < names.size()) {
+        auto pos = names.find(',', cur_p);
+        if (pos == std::string::npos)
+            pos = names.size();
+        local_loggers[names.substr(cur_p, pos - cur_p) + "_daemon"] = "0";
+        cur_p = pos + 1;
+    }
+    conf->UpdateConfig(local_loggers);
+
+    std::unique_ptr< spdlog::details::shm_ring > ring;
+    try{
+        sspdlog::Sspdlogger::Instance(std::make_shared< SspdlogDaemon >(conf));
+        ring.reset(new spdlog::details::shm_ring(conf->GetCurrentConfig(sspdlog::DAEMON_SHM_NAME_KEY),
+            std::stoul(conf->GetCurrentConfig(sspdlog::DAEMON_QUEUE_SIZE_KEY)),
+            std::stoul(conf->GetCurrentConfig(sspdlog::DAEMON_RECORD_SIZE_KEY)),
+            static_cast< unsigned >(std::stoul(conf->GetCurrentConfig(sspdlog::DAEMON_SHM_MODE_KEY), nullptr, 8))));
+    }
+    catch (const std::exception &e){
+        std::cerr << "sspdlogd: " << e.what() << std::endl;
+        return 1;
+    }
+    if (!ring->lock_consumer()) {
+        std::cerr << "sspdlogd: another daemon reads " << ring->name() << std::endl;
+        return 1;
+    }
+    std::signal(SIGINT, on_stop);
+    std::signal(SIGTERM, on_stop);
+
+    auto root = spdlog::get(sspdlog::DEFAULT_LOGGER_NAME);
+    std::map< std::string, std::shared_ptr< spdlog::logger > > loggers;
+    spdlog::details::log_msg msg;
+    bool written = false;
+    auto idle_sleep = std::chrono::microseconds(50);
+    size_t dropped = ring->dropped(), truncated = ring->truncated(), abandoned = ring->abandoned();
+    auto next_report = std::chrono::steady_clock::now();
+    // once stopping, records still being written are waited for unless nothing moves for this long,
+    // more than try_dequeue waits before giving up the record of a stalled process
+    const auto stop_timeout = std::chrono::seconds(2);
+    bool stopping = false;
+    auto last_progress = next_report;
+    while (true) {
+        if (ring->try_dequeue(msg)) {
+            auto &logger = loggers[msg.logger_name];
+            if (!logger)
+                logger = spdlog::get(msg.logger_name) ? spdlog::get(msg.logger_name) : root;
+            try{
+                logger->replay(msg);
+            }
+            catch (const std::exception &e){
+                std::cerr << "sspdlogd: " << e.what() << std::endl;
+            }
+            written = true;
+            idle_sleep = std::chrono::microseconds(50);
+            last_progress = std::chrono::steady_clock::now();
+            continue;
+        }
+
+        // the ring is empty (or waiting for a record being written)
+        if (written) {
+            spdlog::apply_all([](std::shared_ptr< spdlog::logger > l) { l->flush(); });
+            written = false;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (stop_requested) {
+            if (!stopping) {
+                stopping = true;
+                last_progress = now;
+            }
+            if (ring->empty() || now - last_progress >= stop_timeout)
+                break;
+        }
+        if (now >= next_report) {
+            if (ring->dropped() != dropped)
+                root->warn(spdlog::details::add_msg(), "sspdlogd: {} messages dropped, the ring was full", ring->dropped() - dropped);
+            if (ring->truncated() != truncated)
+                root->warn(spdlog::details::add_msg(), "sspdlogd: {} messages cut to the record size", ring->truncated() - truncated);
+            if (ring->abandoned() != abandoned)
+                root->warn(spdlog::details::add_msg(), "sspdlogd: {} messages lost, their process stalled while writing them", ring->abandoned() - abandoned);
+            dropped = ring->dropped();
+            truncated = ring->truncated();
+            abandoned = ring->abandoned();
+            next_report = now + std::chrono::seconds(1);
+        }
+        std::this_thread::sleep_for(idle_sleep);
+        if (idle_sleep < std::chrono::milliseconds(5))
+            idle_sleep *= 2;
+    }
+    spdlog::apply_all([](std::shared_ptr< spdlog::logger > l) { l->flush(); });
+    return 0;
+}
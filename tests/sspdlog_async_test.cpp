@@ -0,0 +1,878 @@
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include <gtest/gtest.h>
+#include <sspdlog/sspdlog.h>
+
+// sink keeping the formatted lines, whose first write blocks until opened
+class GatedSink : public spdlog::sinks::base_sink< std::mutex >
+{
+public:
+    std::atomic< bool > entered{false}, opened{false};
+    std::vector< std::string > lines;
+
+    void flush() override {}
+
+    void WaitEntered()
+    {
+        while (!entered)
+            std::this_thread::yield();
+    }
+
+protected:
+    void _sink_it(const spdlog::details::log_msg &msg) override
+    {
+        entered = true;
+        while (!opened)
+            std::this_thread::yield();
+        lines.push_back(std::string(msg.formatted.data(), msg.formatted.size()));
+    }
+};
+
+class SspdAsyncTest : public testing::Test
+{
+protected:
+    void SetUp() override { sink = std::make_shared< GatedSink >(); }
+    void TearDown() override {}
+
+    std::shared_ptr< spdlog::async_logger > MakeLogger(spdlog::async_overflow_policy policy,
+                                                       const spdlog::async_options &options = spdlog::async_options())
+    {
+        auto logger = std::make_shared< spdlog::async_logger >("async_test", sink, 4, policy, nullptr,
+                                                               std::chrono::milliseconds::zero(), options);
+        logger->set_pattern("%l %v");
+        logger->set_level(spdlog::level::trace);
+        // the first message keeps the worker busy in the sink, so the queue fills up
+        logger->info(SSPD_LOG_LINE_INFO) << "first";
+        sink->WaitEntered();
+        return logger;
+    }
+
+    std::shared_ptr< GatedSink > sink;
+};
+
+TEST_F(SspdAsyncTest, OverwriteOldestKeepsNewest) {
+    auto logger = MakeLogger(spdlog::async_overflow_policy::overwrite_oldest);
+    for (int i = 1; i <= 10; i++)
+        logger->info(SSPD_LOG_LINE_INFO) << i;
+    EXPECT_EQ(6u, logger->dropped(spdlog::level::info));
+    EXPECT_EQ(6u, logger->dropped());
+
+    sink->opened = true;
+    logger.reset();
+    ASSERT_EQ(6u, sink->lines.size());
+    EXPECT_EQ("INFO first\n", sink->lines[0]);
+    EXPECT_EQ("INFO 7\n", sink->lines[1]);
+    EXPECT_EQ("INFO 10\n", sink->lines[4]);
+    EXPECT_EQ("WARNING 6 messages dropped by the async queue overflow policy (INFO: 6)\n", sink->lines[5]);
+}
+
+TEST_F(SspdAsyncTest, DiscardBelowLevelKeepsWarnings) {
+    spdlog::async_options options;
+    auto logger = MakeLogger(spdlog::async_overflow_policy::discard_below_level, options);
+    for (int i = 1; i <= 6; i++)
+        logger->debug(SSPD_LOG_LINE_INFO) << i;
+    EXPECT_EQ(2u, logger->dropped(spdlog::level::debug));
+
+    std::thread warner([&logger]() { logger->warn(SSPD_LOG_LINE_INFO) << "kept"; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    sink->opened = true;
+    warner.join();
+    EXPECT_EQ(2u, logger->dropped());
+    logger.reset();
+    EXPECT_EQ("WARNING kept\n", sink->lines[5]);
+}
+
+TEST_F(SspdAsyncTest, BlockTimeoutGivesUp) {
+    spdlog::async_options options;
+    options.block_timeout = std::chrono::milliseconds(10);
+    options.drop_report_interval = std::chrono::milliseconds::zero();
+    auto logger = MakeLogger(spdlog::async_overflow_policy::block_timeout, options);
+    for (int i = 1; i <= 5; i++)
+        logger->error(SSPD_LOG_LINE_INFO) << i;
+    EXPECT_EQ(1u, logger->dropped(spdlog::level::err));
+
+    sink->opened = true;
+    logger.reset();
+    EXPECT_EQ(5u, sink->lines.size());
+}
+
+TEST_F(SspdAsyncTest, PriorityLaneSkipsTheFlood) {
+    spdlog::async_options options;
+    options.priority_level = spdlog::level::warn;
+    auto logger = MakeLogger(spdlog::async_overflow_policy::discard_log_msg, options);
+    for (int i = 1; i <= 10; i++)
+        logger->debug(SSPD_LOG_LINE_INFO) << i;
+    logger->critical(SSPD_LOG_LINE_INFO) << "urgent";
+    EXPECT_EQ(6u, logger->dropped(spdlog::level::debug));
+    EXPECT_EQ(0u, logger->dropped(spdlog::level::critical));
+
+    sink->opened = true;
+    logger->flush();
+    ASSERT_EQ(6u, sink->lines.size());
+    EXPECT_EQ("CRITICAL urgent\n", sink->lines[1]);
+    EXPECT_EQ("DEBUG 1\n", sink->lines[2]);
+}
+
+TEST_F(SspdAsyncTest, AdaptiveShedsDebugUnderPressure) {
+    spdlog::async_options options;
+    options.shed_interval = std::chrono::milliseconds(10);
+    auto logger = MakeLogger(spdlog::async_overflow_policy::adaptive, options);
+    for (int i = 1; i <= 4; i++)
+        logger->debug(SSPD_LOG_LINE_INFO) << i;
+    // a full queue and a slow first write
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    sink->opened = true;
+    auto wait_stage = [&logger](int stage) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (logger->stats().shed_stage != stage && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return logger->stats().shed_stage;
+    };
+    ASSERT_EQ(1, wait_stage(1));
+
+    for (int i = 0; i < 100; i++)
+        logger->debug(SSPD_LOG_LINE_INFO) << i;
+    logger->warn(SSPD_LOG_LINE_INFO) << "kept";
+    EXPECT_EQ(90u, logger->stats().shed);
+    logger->flush();
+    EXPECT_EQ(0, wait_stage(0));
+
+    logger.reset();
+    auto find_line = [this](const std::string &prefix) {
+        auto it = std::find_if(sink->lines.begin(), sink->lines.end(),
+                               [&prefix](const std::string &line) { return line.find(prefix) == 0; });
+        return it == sink->lines.end() ? std::string() : *it;
+    };
+    EXPECT_NE(std::string::npos, find_line("WARNING load shedding stage 1 (queue ")
+                                     .find("us/msg): keeping 1 of 10 TRACE, DEBUG messages\n"));
+    EXPECT_NE(std::string::npos, find_line("WARNING load shedding stage 0 (queue ")
+                                     .find("us/msg): keeping all messages, 90 shed since the last change (DEBUG: 90)\n"));
+    EXPECT_EQ("WARNING kept\n", find_line("WARNING kept"));
+}
+
+TEST_F(SspdAsyncTest, StatsCountQueueUsage) {
+    spdlog::async_options options;
+    options.block_timeout = std::chrono::milliseconds(10);
+    auto logger = MakeLogger(spdlog::async_overflow_policy::block_timeout, options);
+    for (int i = 1; i <= 5; i++)
+        logger->info(SSPD_LOG_LINE_INFO) << i;
+
+    auto stats = logger->stats();
+    EXPECT_EQ(5u, stats.enqueued);
+    EXPECT_EQ(1u, stats.dequeued);
+    EXPECT_EQ(1u, stats.dropped);
+    EXPECT_EQ(1u, stats.blocked);
+    EXPECT_EQ(4u, stats.depth);
+    EXPECT_EQ(4u, stats.high_water);
+    EXPECT_EQ(4u, stats.capacity);
+    // waited 10ms, so from 2^13us on
+    for (size_t i = 0; i < 14; i++)
+        EXPECT_EQ(0u, stats.wait_us[i]);
+
+    spdlog::register_logger(logger);
+    auto dump = sspdlog::dump_async_log_stats();
+    spdlog::drop("async_test");
+    EXPECT_NE(std::string::npos, dump.find("async_test: enqueued 5, dequeued 1, dropped 1, blocked 1, depth 4/4, high water 4, segments 1, wait us <"));
+
+    sink->opened = true;
+    logger->flush();
+    stats = logger->stats();
+    EXPECT_EQ(6u, stats.enqueued);
+    EXPECT_EQ(6u, stats.dequeued);
+    EXPECT_EQ(0u, stats.depth);
+}
+
+TEST_F(SspdAsyncTest, MemoryBudgetActsAsFullQueue) {
+    spdlog::set_async_memory_budget(100);
+    auto logger = MakeLogger(spdlog::async_overflow_policy::discard_log_msg);
+    const std::string text(30, 'x');
+    for (int i = 0; i < 3; i++)
+        logger->info(spdlog::details::add_msg()) << text;
+    EXPECT_EQ(1u, logger->dropped());
+    EXPECT_EQ(2u * (text.size() + std::strlen("async_test")), spdlog::async_memory_in_use());
+
+    spdlog::set_async_memory_budget(0);
+    sink->opened = true;
+    logger->flush();
+    EXPECT_EQ(0u, spdlog::async_memory_in_use());
+    EXPECT_EQ(3u, sink->lines.size());
+}
+
+TEST_F(SspdAsyncTest, SegmentedQueueGrowsUpToCeiling) {
+    spdlog::async_options options;
+    options.max_queue_segments = 4;
+    auto logger = MakeLogger(spdlog::async_overflow_policy::discard_log_msg, options);
+    EXPECT_EQ(1u, logger->stats().segments);
+    // "first" left its segment partly drained, so the ring wraps onto it after 15 messages
+    for (int i = 1; i <= 20; i++)
+        logger->info(SSPD_LOG_LINE_INFO) << i;
+    EXPECT_EQ(5u, logger->dropped());
+    EXPECT_EQ(4u, logger->stats().segments);
+    EXPECT_EQ(15u, logger->stats().depth);
+    EXPECT_EQ(16u, logger->stats().capacity); // no priority lane by default
+
+    sink->opened = true;
+    logger->flush();
+    ASSERT_EQ(16u, sink->lines.size());
+    for (int i = 1; i <= 15; i++)
+        EXPECT_EQ("INFO " + std::to_string(i) + "\n", sink->lines[i]);
+}
+
+TEST_F(SspdAsyncTest, SegmentedQueueReusesDrainedSegments) {
+    spdlog::async_options options;
+    options.max_queue_segments = 100;
+    sink->opened = true;
+    auto logger = MakeLogger(spdlog::async_overflow_policy::block_retry, options);
+    for (int i = 1; i <= 200; i++) {
+        logger->info(SSPD_LOG_LINE_INFO) << i;
+        logger->flush();
+    }
+    EXPECT_EQ(201u, sink->lines.size());
+    EXPECT_GE(3u, logger->stats().segments);
+}
+
+TEST_F(SspdAsyncTest, SegmentedQueueKeepsEveryProducerOrder) {
+    spdlog::async_options options;
+    options.max_queue_segments = 8;
+    options.formatter_threads = 2;
+    sink->opened = true;
+    auto logger = MakeLogger(spdlog::async_overflow_policy::block_retry, options);
+    const int producers = 4, count = 1000;
+    std::vector< std::thread > threads;
+    for (int t = 0; t < producers; t++)
+        threads.push_back(std::thread([&logger, t]() {
+            for (int i = 0; i < count; i++)
+                logger->info(SSPD_LOG_LINE_INFO) << t << " " << i;
+        }));
+    for (auto &t : threads)
+        t.join();
+    logger->flush();
+
+    ASSERT_EQ(1u + producers * count, sink->lines.size());
+    std::vector< int > next(producers, 0);
+    for (size_t l = 1; l < sink->lines.size(); l++) {
+        std::istringstream line(sink->lines[l].substr(5));
+        int t, i;
+        line >> t >> i;
+        ASSERT_EQ(next[t], i);
+        next[t]++;
+    }
+}
+
+TEST_F(SspdAsyncTest, NumaShardsMergeEveryProducer) {
+    spdlog::async_options options;
+    options.numa_shards = true;
+    // this cpu (0) goes to the second shard, the first one stays idle on single cpu machines
+    options.shard_cpus = { { 1 }, { 0 } };
+    sink->opened = true;
+    auto logger = MakeLogger(spdlog::async_overflow_policy::block_retry, options);
+    EXPECT_EQ(2u, logger->stats().shards);
+    const int producers = 4, count = 250;
+    std::vector< std::thread > threads;
+    for (int t = 0; t < producers; t++)
+        threads.push_back(std::thread([&logger, t]() {
+            for (int i = 0; i < count; i++)
+                logger->info(SSPD_LOG_LINE_INFO) << t << " " << i;
+        }));
+    for (auto &t : threads)
+        t.join();
+    logger->flush();
+
+    ASSERT_EQ(1u + producers * count, sink->lines.size());
+    std::vector< int > next(producers, 0);
+    for (size_t l = 1; l < sink->lines.size(); l++) {
+        std::istringstream line(sink->lines[l].substr(5));
+        int t, i;
+        line >> t >> i;
+        ASSERT_EQ(next[t], i);
+        next[t]++;
+    }
+    logger->info(SSPD_LOG_LINE_INFO) << "last";
+    logger.reset();
+    EXPECT_EQ("INFO last\n", sink->lines.back());
+}
+
+// sink without a lock, written by a shared writer only
+class TimedSink : public spdlog::sinks::base_sink< spdlog::details::null_mutex >
+{
+public:
+    std::vector< std::pair< spdlog::log_clock::time_point, std::string > > lines;
+    int flushes = 0;
+
+    void flush() override { flushes++; }
+
+protected:
+    void _sink_it(const spdlog::details::log_msg &msg) override
+    {
+        lines.push_back(std::make_pair(msg.time, std::string(msg.formatted.data(), msg.formatted.size())));
+    }
+};
+
+TEST_F(SspdAsyncTest, SharedWriterMergesLoggersByTime) {
+    auto timed = std::make_shared< TimedSink >();
+    auto writer = std::make_shared< spdlog::sinks::shared_writer_sink >(timed, std::chrono::seconds(10));
+    const int loggers = 3, count = 300;
+    std::vector< std::shared_ptr< spdlog::async_logger > > async_loggers;
+    for (int l = 0; l < loggers; l++) {
+        async_loggers.push_back(std::make_shared< spdlog::async_logger >("shared_" + std::to_string(l), writer, 64));
+        async_loggers.back()->set_pattern("%n %v");
+    }
+    std::vector< std::thread > threads;
+    for (int l = 0; l < loggers; l++)
+        threads.push_back(std::thread([&async_loggers, l]() {
+            for (int i = 0; i < count; i++)
+                async_loggers[l]->info(SSPD_LOG_LINE_INFO) << i;
+        }));
+    for (auto &t : threads)
+        t.join();
+    // a flush writes out whatever the writer holds, so only flush once every worker handed all its messages over
+    for (auto &logger : async_loggers)
+        while (logger->stats().dequeued != size_t(count))
+            std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_TRUE(timed->lines.empty());
+    for (auto &logger : async_loggers)
+        logger->flush();
+
+    ASSERT_EQ(size_t(loggers * count), timed->lines.size());
+    EXPECT_LE(loggers, timed->flushes);
+    EXPECT_TRUE(std::is_sorted(timed->lines.begin(), timed->lines.end(),
+        [](const std::pair< spdlog::log_clock::time_point, std::string > &a,
+           const std::pair< spdlog::log_clock::time_point, std::string > &b) { return a.first < b.first; }));
+    std::vector< int > next(loggers, 0);
+    for (auto &line : timed->lines) {
+        std::istringstream in(line.second.substr(std::strlen("shared_")));
+        int l, i;
+        in >> l >> i;
+        ASSERT_EQ(next[l], i);
+        next[l]++;
+    }
+}
+
+TEST_F(SspdAsyncTest, FlushWaitsForQueuedMessages) {
+    auto logger = MakeLogger(spdlog::async_overflow_policy::block_retry);
+    for (int i = 1; i <= 3; i++)
+        logger->info(SSPD_LOG_LINE_INFO) << i;
+    EXPECT_FALSE(logger->flush(std::chrono::milliseconds(10)));
+
+    sink->opened = true;
+    EXPECT_TRUE(logger->flush(std::chrono::milliseconds(1000)));
+    EXPECT_EQ(4u, sink->lines.size());
+    for (int i = 4; i <= 100; i++)
+        logger->info(SSPD_LOG_LINE_INFO) << i;
+    logger->flush();
+    EXPECT_EQ(101u, sink->lines.size());
+}
+
+TEST_F(SspdAsyncTest, FormatterThreadsKeepOrder) {
+    spdlog::async_options options;
+    options.formatter_threads = 3;
+    sink->opened = true;
+    auto logger = MakeLogger(spdlog::async_overflow_policy::block_retry, options);
+    for (int i = 1; i <= 1000; i++)
+        logger->info(SSPD_LOG_LINE_INFO) << i;
+    logger->flush();
+    ASSERT_EQ(1001u, sink->lines.size());
+    for (int i = 1; i <= 1000; i++)
+        EXPECT_EQ("INFO " + std::to_string(i) + "\n", sink->lines[i]);
+}
+
+TEST_F(SspdAsyncTest, PatternCachesTheSecondPrefix) {
+    spdlog::pattern_formatter formatter("[%Y-%m-%d %H:%M:%S.%e] %l %v");
+    auto second = spdlog::log_clock::from_time_t(1500000000);
+    auto format = [&formatter](spdlog::log_clock::time_point time, const char *text) {
+        spdlog::details::log_msg msg(spdlog::level::info);
+        msg.time = time;
+        msg.raw << text;
+        formatter.format(msg);
+        return std::string(msg.formatted.data(), msg.formatted.size());
+    };
+    auto expected = [](std::time_t t, const char *rest) {
+        auto tm_time = spdlog::details::os::localtime(t);
+        char buf[32];
+        std::strftime(buf, sizeof(buf), "[%Y-%m-%d %H:%M:%S.", &tm_time);
+        return std::string(buf) + rest + spdlog::details::os::eol();
+    };
+    EXPECT_EQ(expected(1500000000, "012] INFO a"), format(second + std::chrono::milliseconds(12), "a"));
+    EXPECT_EQ(expected(1500000000, "999] INFO b"), format(second + std::chrono::milliseconds(999), "b"));
+    EXPECT_EQ(expected(1500000001, "000] INFO c"), format(second + std::chrono::seconds(1), "c"));
+    EXPECT_EQ(expected(1500000000, "500] INFO d"), format(second + std::chrono::milliseconds(500), "d"));
+}
+
+TEST_F(SspdAsyncTest, PatternPlanRendersEveryFlag) {
+    spdlog::pattern_formatter formatter("%a %b %D %T %r %R %p|%L|%t|%Q#Q %% #f:#l #F|%+");
+    spdlog::details::log_msg msg(spdlog::level::warn);
+    msg.logger_name = "plan";
+    msg.time = spdlog::log_clock::from_time_t(1484000000) + std::chrono::milliseconds(7);
+    msg.thread_id = 42;
+    msg.a_msg = spdlog::details::add_msg("/src/dir/plan.cpp", "run", 12);
+    msg.raw << "text";
+    formatter.format(msg);
+
+    auto tm_time = spdlog::details::os::localtime(1484000000);
+    char date[64], full[32];
+    std::strftime(date, sizeof(date), "%a %b %m/%d/%y %H:%M:%S %I:%M:%S %p %H:%M %p", &tm_time);
+    std::strftime(full, sizeof(full), "%Y-%m-%d %H:%M:%S", &tm_time);
+    EXPECT_EQ(std::string(date) + "|W|42|%Q#Q %% plan.cpp:12 run|[" + full + ".007] [plan] [WARNING] text" +
+              spdlog::details::os::eol(), std::string(msg.formatted.data(), msg.formatted.size()));
+}
+
+TEST_F(SspdAsyncTest, StaticPatternMatchesPatternFormatter) {
+    spdlog::pattern_formatter formatter("%a %b %D %T %r %R %p|%L|%t|%Q#Q %% #f:#l #F|%+ ##l [%-8l|%.2#F|%6#l|%-4.2Y] %5");
+    SPDLOG_STATIC_PATTERN("%a %b %D %T %r %R %p|%L|%t|%Q#Q %% #f:#l #F|%+ ##l [%-8l|%.2#F|%6#l|%-4.2Y] %5") static_formatter;
+    spdlog::details::log_msg msg(spdlog::level::warn), static_msg(spdlog::level::warn);
+    for (auto m : { &msg, &static_msg }) {
+        m->logger_name = "plan";
+        m->time = spdlog::log_clock::from_time_t(1484000000) + std::chrono::milliseconds(7);
+        m->thread_id = 42;
+        m->a_msg = spdlog::details::add_msg("/src/dir/plan.cpp", "run", 12);
+        m->raw << "text";
+    }
+    formatter.format(msg);
+    static_formatter.format(static_msg);
+    EXPECT_EQ(std::string(msg.formatted.data(), msg.formatted.size()),
+              std::string(static_msg.formatted.data(), static_msg.formatted.size()));
+}
+
+TEST_F(SspdAsyncTest, PatternModifiersAlignAndCut) {
+    spdlog::pattern_formatter formatter("[%-8l][%8n][%.3v][%-6#l][%.4#F][#-5l][%3.4v][%-3Q]");
+    spdlog::details::log_msg msg(spdlog::level::info);
+    msg.logger_name = "net";
+    msg.a_msg = spdlog::details::add_msg("/src/net.cpp", "on_accept", 42);
+    msg.raw << "caf\xc3\xa9 ok";    // the cut at 4 bytes would split the last char of "café"
+    formatter.format(msg);
+    EXPECT_EQ(std::string("[INFO    ][     net][caf][42    ][on_a][42   ][caf][%-3Q]") + spdlog::details::os::eol(),
+              std::string(msg.formatted.data(), msg.formatted.size()));
+}
+
+TEST_F(SspdAsyncTest, FixedTimeZonesSkipLocaltime) {
+    // leap days, century years, negative times
+    for (std::time_t t : { std::time_t(0), std::time_t(-1), std::time_t(-86400 * 400LL), std::time_t(951782400),
+                           std::time_t(4107542399LL), std::time_t(1484000000), std::time_t(1709164800) }) {
+        for (std::time_t step = 0; step < 3 * 86400; step += 3607) {
+            auto expected = spdlog::details::os::gmtime(t + step);
+            auto civil = spdlog::details::os::civil_time(t + step, 0);
+            EXPECT_TRUE(spdlog::details::os::operator==(expected, civil)) << t + step;
+            EXPECT_EQ(expected.tm_wday, civil.tm_wday) << t + step;
+            EXPECT_EQ(expected.tm_yday, civil.tm_yday) << t + step;
+        }
+    }
+
+    spdlog::pattern_formatter formatter("%Y-%m-%d %H:%M:%S %z %a", spdlog::time_zone::fixed(-(5 * 60 + 30)));
+    spdlog::details::log_msg msg(spdlog::level::info);
+    msg.time = spdlog::log_clock::from_time_t(1484000000);
+    formatter.format(msg);
+    EXPECT_EQ(std::string("2017-01-09 16:43:20 -05:30 Mon") + spdlog::details::os::eol(),
+              std::string(msg.formatted.data(), msg.formatted.size()));
+
+    // the second before the epoch is a second like the others for the caches
+    spdlog::pattern_formatter utc_formatter("%Y-%m-%d %H:%M:%S", spdlog::time_zone::utc());
+    msg.formatted.clear();
+    msg.time = spdlog::log_clock::from_time_t(-1);
+    utc_formatter.format(msg);
+    EXPECT_EQ(std::string("1969-12-31 23:59:59") + spdlog::details::os::eol(),
+              std::string(msg.formatted.data(), msg.formatted.size()));
+}
+
+TEST_F(SspdAsyncTest, JsonFormatterEscapesStrings) {
+    spdlog::json_formatter formatter(spdlog::time_zone::utc());
+    spdlog::details::log_msg msg(spdlog::level::warn);
+    msg.logger_name = "json";
+    msg.time = spdlog::log_clock::from_time_t(1484000000) + std::chrono::milliseconds(7);
+    msg.thread_id = 42;
+    msg.a_msg = spdlog::details::add_msg("/src/dir/js\"on.cpp", "run", 12);
+    // long enough for the escapes to be found in the middle of and after whole 16 byte blocks
+    msg.raw << "a \"quoted\" path C:\\dir\\file and \x01 control, tab\tnew line\n and utf-8 caf\xc3\xa9 done";
+    formatter.format(msg);
+    EXPECT_EQ(std::string("{\"time\":\"2017-01-09T22:13:20.007+00:00\",\"level\":\"WARNING\",\"logger\":\"json\",\"thread\":42,"
+                          "\"file\":\"js\\\"on.cpp\",\"line\":12,\"func\":\"run\",\"msg\":\"a \\\"quoted\\\" path C:\\\\dir\\\\file and "
+                          "\\u0001 control, tab\\tnew line\\n and utf-8 caf\xc3\xa9 done\"}") + spdlog::details::os::eol(),
+              std::string(msg.formatted.data(), msg.formatted.size()));
+
+    spdlog::details::log_msg plain(spdlog::level::info);
+    plain.time = msg.time;
+    plain.thread_id = 7;
+    formatter.format(plain);
+    EXPECT_EQ(std::string("{\"time\":\"2017-01-09T22:13:20.007+00:00\",\"level\":\"INFO\",\"logger\":\"\",\"thread\":7,\"msg\":\"\"}") +
+              spdlog::details::os::eol(), std::string(plain.formatted.data(), plain.formatted.size()));
+
+    // invalid UTF-8 (a stray byte in a 16 byte block, a cut sequence at the end) would make the line invalid JSON
+    plain.formatted.clear();
+    plain.raw << "stray \xff byte, then \xe2\x82\xac and a cut \xe2\x82";
+    formatter.format(plain);
+    EXPECT_EQ(std::string("{\"time\":\"2017-01-09T22:13:20.007+00:00\",\"level\":\"INFO\",\"logger\":\"\",\"thread\":7,"
+                          "\"msg\":\"stray \\ufffd byte, then \xe2\x82\xac and a cut \\ufffd\\ufffd\"}") + spdlog::details::os::eol(),
+              std::string(plain.formatted.data(), plain.formatted.size()));
+}
+
+// pattern formatter counting its calls
+class CountingFormatter : public spdlog::pattern_formatter
+{
+public:
+    explicit CountingFormatter(const std::string &pattern) : spdlog::pattern_formatter(pattern) {}
+    std::atomic< int > calls{0};
+
+    void format(spdlog::details::log_msg &msg) override
+    {
+        ++calls;
+        spdlog::pattern_formatter::format(msg);
+    }
+};
+
+TEST_F(SspdAsyncTest, SinkFormattersRenderOncePerFormat) {
+    sink->opened = true;
+    auto json_sink = std::make_shared< GatedSink >(), other_json_sink = std::make_shared< GatedSink >();
+    auto same_sink = std::make_shared< GatedSink >();
+    json_sink->opened = other_json_sink->opened = same_sink->opened = true;
+    auto logger_formatter = std::make_shared< CountingFormatter >("%l %v");
+    auto json_formatter = std::make_shared< CountingFormatter >("{\"msg\":\"%v\"}");
+    json_sink->set_formatter(json_formatter);
+    other_json_sink->set_formatter(json_formatter);
+    same_sink->set_formatter(logger_formatter);
+
+    auto logger = std::make_shared< spdlog::logger >("sink_formats", spdlog::sinks_init_list{ json_sink, sink, other_json_sink, same_sink });
+    logger->set_formatter(logger_formatter);
+    logger->info(SSPD_LOG_LINE_INFO) << "one";
+    logger->info(SSPD_LOG_LINE_INFO) << "two";
+
+    EXPECT_EQ(2, logger_formatter->calls);
+    EXPECT_EQ(2, json_formatter->calls);
+    EXPECT_EQ((std::vector< std::string >{ "INFO one\n", "INFO two\n" }), sink->lines);
+    EXPECT_EQ(sink->lines, same_sink->lines);
+    EXPECT_EQ((std::vector< std::string >{ "{\"msg\":\"one\"}\n", "{\"msg\":\"two\"}\n" }), json_sink->lines);
+    EXPECT_EQ(json_sink->lines, other_json_sink->lines);
+}
+
+TEST_F(SspdAsyncTest, FileBaseNameFoundAtCompileTime) {
+    static_assert(spdlog::details::file_base_offset("/src/net/server.cpp") == 9, "base name");
+    static_assert(spdlog::details::file_base_offset("C:\\src\\main.cpp") == 7, "windows base name");
+    static_assert(spdlog::details::file_base_offset("main.cpp") == 0, "no directory");
+    static_assert(spdlog::details::file_base_offset("/src/net/server.cpp", "/src/") == 5, "prefix");
+    static_assert(spdlog::details::file_base_offset("/lib/net/server.cpp", "/src/") == 9, "other prefix");
+
+    spdlog::pattern_formatter formatter("#f:#l");
+    spdlog::details::log_msg msg(spdlog::level::info);
+    msg.a_msg = SSPD_LOG_LINE_INFO;
+    int line = __LINE__ - 1;
+    formatter.format(msg);
+    EXPECT_EQ("sspdlog_async_test.cpp:" + std::to_string(line) + spdlog::details::os::eol(),
+              std::string(msg.formatted.data(), msg.formatted.size()));
+
+    // the call site's names are pointed to, not copied
+    EXPECT_EQ(0u, msg.a_msg.file_name.owned_size() + msg.a_msg.func_name.owned_size());
+
+    msg.formatted.clear();
+    msg.a_msg = spdlog::details::add_msg::call_site("/src/net/server.cpp", 5, "run", 7);
+    formatter.format(msg);
+    EXPECT_EQ(std::string("net/server.cpp:7") + spdlog::details::os::eol(),
+              std::string(msg.formatted.data(), msg.formatted.size()));
+}
+
+TEST_F(SspdAsyncTest, SanitizeEscapesControlsAndBadUtf8) {
+    sink->opened = true;
+    auto logger = std::make_shared< spdlog::logger >("sanitize", sink);
+    logger->set_pattern("%v");
+    // a clean message longer than a 16 byte block, with valid UTF-8, goes through untouched
+    std::string clean = "plain ascii text then caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80 and more plain text";
+    // a forged line with an ANSI escape, then a lone continuation byte, an overlong '/', a surrogate, a cut sequence
+    std::string dirty = "user=bob\n[ERROR] forged \x1b[31mred\x1b[0m\t\x80 \xc0\xaf \xed\xa0\x80 end \xe2\x82";
+    // escapes written by the message itself, found in a 16 byte block and in the tail
+    std::string slashes = "path C:\\tmp\\new then \\x1b\\n";
+
+    logger->set_sanitize(spdlog::sanitize_mode::escape);
+    logger->info(SSPD_LOG_LINE_INFO) << clean;
+    logger->info(SSPD_LOG_LINE_INFO) << dirty;
+    logger->info(SSPD_LOG_LINE_INFO) << slashes;
+    logger->set_sanitize(spdlog::sanitize_mode::replace);
+    logger->info(SSPD_LOG_LINE_INFO) << "a\x7f" << "b\xff\\";
+    logger->set_sanitize(spdlog::sanitize_mode::none);
+    logger->info(SSPD_LOG_LINE_INFO) << "as\nis";
+
+    std::string eol = spdlog::details::os::eol();
+    ASSERT_EQ(5u, sink->lines.size());
+    EXPECT_EQ(clean + eol, sink->lines[0]);
+    EXPECT_EQ("user=bob\\n[ERROR] forged \\x1b[31mred\\x1b[0m\\t\\x80 \\xc0\\xaf \\xed\\xa0\\x80 end \\xe2\\x82" + eol,
+              sink->lines[1]);
+    EXPECT_EQ("path C:\\\\tmp\\\\new then \\\\x1b\\\\n" + eol, sink->lines[2]);
+    EXPECT_EQ("a\xef\xbf\xbd" "b\xef\xbf\xbd\\" + eol, sink->lines[3]);
+    EXPECT_EQ("as\nis" + eol, sink->lines[4]);
+}
+
+#ifdef __linux__
+TEST_F(SspdAsyncTest, PollModeDrainsInCallerThread) {
+    spdlog::async_options options;
+    options.poll_mode = true;
+    sink->opened = true;
+    auto logger = std::make_shared< spdlog::async_logger >("async_test", sink, 4, spdlog::async_overflow_policy::block_retry,
+                                                           nullptr, std::chrono::milliseconds::zero(), options);
+    logger->set_pattern("%l %v");
+    spdlog::register_logger(logger);
+    spdlog::drain_async();
+    for (int i = 1; i <= 3; i++)
+        logger->info(SSPD_LOG_LINE_INFO) << i;
+    EXPECT_TRUE(sink->lines.empty());
+    struct pollfd pfd = { sspdlog::poll_fd(), POLLIN, 0 };
+    EXPECT_EQ(1, poll(&pfd, 1, 0));
+
+    EXPECT_EQ(2u, sspdlog::drain(2));
+    EXPECT_EQ(2u, sink->lines.size());
+    // one message left, so still readable
+    EXPECT_EQ(1, poll(&pfd, 1, 0));
+    EXPECT_EQ(1u, sspdlog::drain());
+    EXPECT_EQ(0, poll(&pfd, 1, 0));
+
+    // a full queue is drained by the logging thread itself
+    for (int i = 4; i <= 10; i++)
+        logger->info(SSPD_LOG_LINE_INFO) << i;
+    EXPECT_TRUE(logger->flush(std::chrono::seconds(5)));
+    spdlog::drop("async_test");
+    ASSERT_EQ(10u, sink->lines.size());
+    EXPECT_EQ("INFO 1\n", sink->lines[0]);
+    EXPECT_EQ("INFO 10\n", sink->lines[9]);
+}
+
+// sink logging and flushing back into its own logger
+class EchoSink : public spdlog::sinks::base_sink< spdlog::details::null_mutex >
+{
+public:
+    spdlog::async_logger *logger = nullptr;
+    std::vector< std::string > lines;
+    bool flushed = true;
+
+    void flush() override {}
+
+protected:
+    void _sink_it(const spdlog::details::log_msg &msg) override
+    {
+        lines.push_back(std::string(msg.formatted.data(), msg.formatted.size()));
+        if (lines.size() > 1)
+            return;
+        for (int i = 1; i <= 10; i++)
+            logger->info(SSPD_LOG_LINE_INFO) << i;
+        logger->flush();
+        flushed = logger->flush(std::chrono::seconds(5));
+    }
+};
+
+TEST_F(SspdAsyncTest, PollModeSinkLogsIntoItsOwnDrain) {
+    spdlog::async_options options;
+    options.poll_mode = true;
+    auto echo = std::make_shared< EchoSink >();
+    auto logger = std::make_shared< spdlog::async_logger >("async_test", echo, 4, spdlog::async_overflow_policy::block_retry,
+                                                           nullptr, std::chrono::milliseconds::zero(), options);
+    logger->set_pattern("%l %v");
+    echo->logger = logger.get();
+    logger->info(SSPD_LOG_LINE_INFO) << "echo";
+    // neither waits for the drain it runs in
+    EXPECT_EQ(5u, logger->drain(100, std::chrono::microseconds::max()));
+    EXPECT_FALSE(echo->flushed);
+    EXPECT_EQ(6u, logger->dropped(spdlog::level::info));
+    ASSERT_EQ(5u, echo->lines.size());
+    EXPECT_EQ("INFO echo\n", echo->lines[0]);
+    EXPECT_EQ("INFO 4\n", echo->lines[4]);
+}
+
+TEST_F(SspdAsyncTest, SinkLogsIntoItsOwnWorker) {
+    auto echo = std::make_shared< EchoSink >();
+    auto logger = std::make_shared< spdlog::async_logger >("async_test", echo, 4, spdlog::async_overflow_policy::block_retry);
+    logger->set_pattern("%l %v");
+    echo->logger = logger.get();
+    logger->info(SSPD_LOG_LINE_INFO) << "echo";
+    // the first marker may get in the queue before the echoes
+    EXPECT_TRUE(logger->flush(std::chrono::seconds(5)));
+    EXPECT_TRUE(logger->flush(std::chrono::seconds(5)));
+    EXPECT_FALSE(echo->flushed);
+    EXPECT_LE(6u, logger->dropped(spdlog::level::info));
+    EXPECT_EQ(11u - logger->dropped(spdlog::level::info), echo->lines.size());
+    EXPECT_EQ("INFO 1\n", echo->lines[1]);
+}
+
+TEST_F(SspdAsyncTest, LowLatencyOptionsKeepLogging) {
+    spdlog::async_options options;
+    options.lock_memory = true;
+    options.huge_pages = true;
+    options.warm_up = true;
+    sink->opened = true;
+    auto logger = std::make_shared< spdlog::async_logger >("async_test", sink, 1024, spdlog::async_overflow_policy::block_retry,
+                                                           nullptr, std::chrono::milliseconds::zero(), options);
+    logger->set_pattern("%l %v");
+    logger->info(SSPD_LOG_LINE_INFO) << "fast";
+    logger->flush();
+    ASSERT_EQ(1u, sink->lines.size());
+    EXPECT_EQ("INFO fast\n", sink->lines[0]);
+
+    options.max_queue_segments = 4;
+    EXPECT_THROW(spdlog::async_logger("async_test", sink, 1024, spdlog::async_overflow_policy::block_retry,
+                                      nullptr, std::chrono::milliseconds::zero(), options), spdlog::spdlog_ex);
+}
+
+TEST_F(SspdAsyncTest, CrashDrainsQueuedMessages) {
+    const char *filename = "sspdlog_crash_test.txt";
+    std::remove(filename);
+    EXPECT_EXIT({
+        auto file = std::make_shared< spdlog::sinks::simple_file_sink_mt >(filename, false);
+        auto logger = std::make_shared< spdlog::async_logger >(
+            "crash_test", spdlog::sinks_init_list{ sink, file }, 16, spdlog::async_overflow_policy::block_retry);
+        logger->info(SSPD_LOG_LINE_INFO) << "first";
+        sink->WaitEntered();
+        for (int i = 1; i <= 3; i++)
+            logger->error(SSPD_LOG_LINE_INFO) << "queued " << i;
+        spdlog::install_crash_handler();
+        std::abort();
+    }, testing::KilledBySignal(SIGABRT), "");
+
+    std::ifstream in(filename);
+    std::stringstream content;
+    content << in.rdbuf();
+    EXPECT_NE(std::string::npos, content.str().find("UTC] [ERROR] [crash_test] queued 1 (sspdlog_async_test.cpp #"));
+    EXPECT_NE(std::string::npos, content.str().find("queued 3"));
+    std::remove(filename);
+}
+
+TEST_F(SspdAsyncTest, ForkGivesTheChildItsOwnWorkerAndFile) {
+    const char *filename = "sspdlog_fork_test.txt";
+    std::remove(filename);
+    spdlog::install_fork_handler();
+    auto file = std::make_shared< spdlog::sinks::simple_file_sink_mt >(filename, false);
+    file->set_child_pid_suffix(true);
+    spdlog::async_options options;
+    options.formatter_threads = 1;
+    auto logger = std::make_shared< spdlog::async_logger >("fork_test", file, 64, spdlog::async_overflow_policy::block_retry,
+                                                           nullptr, std::chrono::milliseconds::zero(), options);
+    logger->set_pattern("%v");
+    for (int i = 0; i < 50; i++)
+        logger->info(SSPD_LOG_LINE_INFO) << "parent " << i;
+
+    pid_t child = fork();
+    if (child == 0) {
+        // a deadlock kills the child instead of hanging the test
+        alarm(10);
+        logger->info(SSPD_LOG_LINE_INFO) << "child";
+        logger->flush();
+        _exit(0);
+    }
+    ASSERT_GT(child, 0);
+    logger->info(SSPD_LOG_LINE_INFO) << "parent after fork";
+    logger->flush();
+    int status = 0;
+    waitpid(child, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    auto read = [](const std::string &name) {
+        std::ifstream in(name);
+        std::stringstream content;
+        content << in.rdbuf();
+        return content.str();
+    };
+    auto parent_lines = read(filename);
+    EXPECT_EQ(0u, parent_lines.find("parent 0\n"));
+    EXPECT_EQ(parent_lines.rfind("parent 0\n"), parent_lines.find("parent 0\n"));
+    EXPECT_NE(std::string::npos, parent_lines.find("parent 49\nparent after fork\n"));
+    EXPECT_EQ(std::string::npos, parent_lines.find("child"));
+    auto child_file = std::string(filename) + "." + std::to_string(child);
+    EXPECT_EQ("child\n", read(child_file));
+    std::remove(filename);
+    std::remove(child_file.c_str());
+}
+
+TEST_F(SspdAsyncTest, ShmLoggerHandsRawMessagesToTheDaemonRing) {
+    auto name = "/sspdlog_shm_test_" + std::to_string(getpid());
+    spdlog::details::shm_ring::unlink(name);
+    {
+        spdlog::shm_logger logger("shm_test", name, 4, 256);
+        logger.set_level(spdlog::level::debug);
+        struct stat st;
+        ASSERT_EQ(0, ::stat(("/dev/shm" + name).c_str(), &st));
+        EXPECT_EQ(0600u, st.st_mode & 0777u);
+        logger.warn(spdlog::details::add_msg("shm.cpp", "func", 7), "hello {}", 1);
+
+        // the daemon attaches to the ring as created, and is the only consumer
+        spdlog::details::shm_ring daemon(name, 1024, 1024);
+        EXPECT_EQ(4u, daemon.capacity());
+        EXPECT_EQ(256u, daemon.record_size());
+        ASSERT_TRUE(daemon.lock_consumer());
+        spdlog::details::shm_ring other(name, 4, 256);
+        EXPECT_FALSE(other.lock_consumer());
+
+        logger.info(SSPD_LOG_LINE_INFO) << std::string(1000, 'x');
+        for (int i = 0; i < 4; i++)
+            logger.info(SSPD_LOG_LINE_INFO) << "more " << i;
+        EXPECT_EQ(2u, logger.dropped());
+        EXPECT_EQ(1u, daemon.truncated());
+
+        spdlog::details::log_msg msg;
+        ASSERT_TRUE(daemon.try_dequeue(msg));
+        EXPECT_EQ("shm_test", msg.logger_name);
+        EXPECT_EQ(spdlog::level::warn, msg.level);
+        EXPECT_EQ(spdlog::details::os::thread_id(), msg.thread_id);
+        EXPECT_EQ("hello 1", std::string(msg.raw.data(), msg.raw.size()));
+        EXPECT_EQ(0u, msg.formatted.size());
+        EXPECT_EQ("shm.cpp", msg.a_msg.file_name.str());
+        EXPECT_EQ("func", msg.a_msg.func_name.str());
+        EXPECT_EQ(7, msg.a_msg.line_num);
+        ASSERT_TRUE(daemon.try_dequeue(msg));
+        EXPECT_LT(msg.raw.size(), 256u);
+        ASSERT_TRUE(daemon.try_dequeue(msg));
+        EXPECT_EQ("more 0", std::string(msg.raw.data(), msg.raw.size()));
+        ASSERT_TRUE(daemon.try_dequeue(msg));
+        EXPECT_FALSE(daemon.try_dequeue(msg));
+    }
+    spdlog::details::shm_ring::unlink(name);
+}
+#endif
+
+class WarmupSspdlogger : public sspdlog::Sspdlogger
+{
+public:
+    WarmupSspdlogger(const std::shared_ptr< sspdlog::SspdlogConfig > &conf) : Sspdlogger(conf) {}
+    using Sspdlogger::LoadWorkerWarmup;
+    using Sspdlogger::LoadSinks;
+};
+
+TEST_F(SspdAsyncTest, WorkerWarmupFromConfig) {
+    auto conf = std::make_shared< sspdlog::SspdlogConfig >();
+    WarmupSspdlogger loader(conf);
+    EXPECT_EQ(nullptr, loader.LoadWorkerWarmup("root_logger", conf));
+
+    conf->UpdateConfig({ { "root_logger_worker_cpus", "0" }, { "root_logger_worker_name", "sspd_worker_test" } });
+    auto warmup = loader.LoadWorkerWarmup("root_logger", conf);
+    ASSERT_NE(nullptr, warmup);
+#ifdef __linux__
+    std::string name;
+    std::thread worker([&warmup, &name]() {
+        warmup();
+        char buf[16];
+        pthread_getname_np(pthread_self(), buf, sizeof(buf));
+        name = buf;
+    });
+    worker.join();
+    EXPECT_EQ("sspd_worker_tes", name);
+#endif
+
+    conf->UpdateConfig({ { "root_logger_worker_sched", "fast" } });
+    EXPECT_THROW(loader.LoadWorkerWarmup("root_logger", conf), sspdlog::SspdlogInitError);
+}
+
+TEST_F(SspdAsyncTest, SinkFormatOnlyForItsOwnSink) {
+    auto conf = std::make_shared< sspdlog::SspdlogConfig >();
+    conf->UpdateConfig({ { "file_sink_format", "json" }, { "file_full_name", "sink_format_test" } });
+    WarmupSspdlogger loader(conf);
+    auto sinks = loader.LoadSinks({ "console", "file" }, conf);
+    ASSERT_EQ(2u, sinks.size());
+    EXPECT_EQ(nullptr, sinks[0]->get_formatter());
+    EXPECT_NE(nullptr, std::dynamic_pointer_cast< spdlog::json_formatter >(sinks[1]->get_formatter()));
+    std::remove("sink_format_test.log");
+}
@@ -49,7 +49,7 @@ TEST_F(SspdBasicTest, LogNoExceptions) {
         if (tmp.length() > 0)
             s = tmp;
     }
-    std::string target = "- [info] - Test log info for LogFileAsExpected(sspdlog_basic_test.cpp #43)";
+    std::string target = "- [INFO] - Test log info for LogFileAsExpected(sspdlog_basic_test.cpp #43)";
     EXPECT_STREQ(target.c_str(), s.substr(s.length() - target.length()).c_str());
 }
 